@@ -11,22 +11,28 @@
 #include <ArduCAM.h>
 #include <SPI.h>
 #include "memorysaver.h"
+#include "camera_pipeline.h"
+#include "serial_sink.h"
+#include "camera_commands.h"
+#include "resolution_controller.h"
+#include "bmp_rows.h"
 //This demo can only work on OV2640_MINI_2MP platform.
 #if !(defined OV2640_MINI_2MP)
   #error Please select the hardware platform and camera module in the ../libraries/ArduCAM/memorysaver.h file
 #endif
-#define BMPIMAGEOFFSET 66
-const char bmp_header[BMPIMAGEOFFSET] PROGMEM =
-{
-  0x42, 0x4D, 0x36, 0x58, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x00, 0x00, 0x00, 0x28, 0x00,
-  0x00, 0x00, 0x40, 0x01, 0x00, 0x00, 0xF0, 0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0x00, 0x03, 0x00,
-  0x00, 0x00, 0x00, 0x58, 0x02, 0x00, 0xC4, 0x0E, 0x00, 0x00, 0xC4, 0x0E, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0xE0, 0x07, 0x00, 0x00, 0x1F, 0x00,
-  0x00, 0x00
-};
 // set pin 7 as the slave select for the digital pot:
 const int CS = 7;
-bool is_header = false;
+#if defined(__SAM3X8E__)
+  #define SERIAL_BAUD 115200
+#else
+  #define SERIAL_BAUD 921600
+#endif
+SerialSink sink(Serial, SERIAL_BAUD); // block writes, waits only when the TX buffer is full
+//Set to 1 to report "ACK CMD <bytes> B in <ms> ms = <B/s> ... END" after each image
+#define SERIAL_SINK_MEASURE 0
+//Mode 3 ships this part of the 320x240 RGB565 frame, read one scanline at a time.
+//The default is the full frame in RGB565; set it with command 0x32.
+RowWindow bmpWindow = {0, 0, 320, 240, 1, false};
 int mode = 0;
 uint8_t start_capture = 0;
 #if defined (OV2640_MINI_2MP)
@@ -34,18 +40,46 @@ uint8_t start_capture = 0;
 #else
   ArduCAM myCAM( OV5642, CS );
 #endif
-uint8_t read_fifo_burst(ArduCAM myCAM);
+CameraPipeline camera(myCAM); // capture, JPEG framing and FIFO read-out
+CameraSettings settings(myCAM); // what the sensor holds; only changed settings are written
+CameraCommandQueue commands; // setting (0x40..0x87) and profile (0x90..) commands, applied between frames
+//Video streaming frame rate, reported before and after each burst of setting commands
+#define FPS_AFTER_FRAMES 10
+unsigned long fpsSince = 0;
+uint16_t fpsFrames = 0;
+bool fpsAfterPending = false;
+//Print "ACK CMD FPS <when> <fps> (<frames> frames in <ms> ms) END" and start a new window
+void report_fps(const char *when)
+{
+  unsigned long now = millis();
+  unsigned long ms = now - fpsSince;
+  unsigned long fps10 = ms ? (fpsFrames * 10000UL + ms / 2) / ms : 0;
+  Serial.print(F("ACK CMD FPS "));
+  Serial.print(when);
+  Serial.print(' ');
+  Serial.print(fps10 / 10);
+  Serial.print('.');
+  Serial.print(fps10 % 10);
+  Serial.print(F(" ("));
+  Serial.print(fpsFrames);
+  Serial.print(F(" frames in "));
+  Serial.print(ms);
+  Serial.println(F(" ms) END"));
+  fpsSince = now;
+  fpsFrames = 0;
+}
+uint8_t read_fifo_burst();
+void set_bmp_window();
 void setup() {
 // put your setup code here, to run once:
 uint8_t vid, pid;
 uint8_t temp;
 #if defined(__SAM3X8E__)
   Wire1.begin();
-  Serial.begin(115200);
 #else
   Wire.begin();
-  Serial.begin(921600);
 #endif
+  Serial.begin(SERIAL_BAUD);
 Serial.println(F("ACK CMD ArduCAM Start! END"));
 // set the CS as an output:
 pinMode(CS, OUTPUT);
@@ -102,7 +136,7 @@ while(1){
 myCAM.set_format(JPEG);
 myCAM.InitCAM();
 #if defined (OV2640_MINI_2MP)
-  myCAM.OV2640_set_JPEG_size(OV2640_320x240);
+  settings.setSize(OV2640_320x240);
 #else
   myCAM.write_reg(ARDUCHIP_TIM, VSYNC_LEVEL_MASK);   //VSYNC is active HIGH
   myCAM.OV5642_set_JPEG_size(OV5642_320x240);
@@ -115,58 +149,22 @@ myCAM.write_reg(ARDUCHIP_FRAMES,0x00);
 }
 void loop() {
 // put your main code here, to run repeatedly:
-uint8_t temp = 0xff, temp_last = 0;
-bool is_header = false;
+uint8_t temp = 0xff;
 if (Serial.available())
 {
   temp = Serial.read();
   switch (temp)
   {
-    case 0:
-      myCAM.OV2640_set_JPEG_size(OV2640_160x120);delay(1000);
-      Serial.println(F("ACK CMD switch to OV2640_160x120 END"));
-     temp = 0xff;
-    break;
-    case 1:
-      myCAM.OV2640_set_JPEG_size(OV2640_176x144);delay(1000);
-      Serial.println(F("ACK CMD switch to OV2640_176x144 END"));
-    temp = 0xff;
-    break;
-    case 2: 
-      myCAM.OV2640_set_JPEG_size(OV2640_320x240);delay(1000);
-      Serial.println(F("ACK CMD switch to OV2640_320x240 END"));
-    temp = 0xff;
-    break;
-    case 3:
-    myCAM.OV2640_set_JPEG_size(OV2640_352x288);delay(1000);
-    Serial.println(F("ACK CMD switch to OV2640_352x288 END"));
-   temp = 0xff;
-    break;
-    case 4:
-      myCAM.OV2640_set_JPEG_size(OV2640_640x480);delay(1000);
-      Serial.println(F("ACK CMD switch to OV2640_640x480 END"));
-    temp = 0xff;
-    break;
-    case 5:
-    myCAM.OV2640_set_JPEG_size(OV2640_800x600);delay(1000);
-    Serial.println(F("ACK CMD switch to OV2640_800x600 END"));
-    temp = 0xff;
-    break;
-    case 6:
-     myCAM.OV2640_set_JPEG_size(OV2640_1024x768);delay(1000);
-     Serial.println(F("ACK CMD switch to OV2640_1024x768 END"));
+    case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7: case 8:
+    //JPEG sizes in RESOLUTION_LADDER order; the next frame is dropped instead of waiting
+    settings.setSize(RESOLUTION_LADDER[temp].size);
+    Serial.print(F("ACK CMD switch to OV2640_"));
+    Serial.print(RESOLUTION_LADDER[temp].width);
+    Serial.print('x');
+    Serial.print(RESOLUTION_LADDER[temp].height);
+    Serial.println(F(" END"));
     temp = 0xff;
     break;
-    case 7:
-    myCAM.OV2640_set_JPEG_size(OV2640_1280x1024);delay(1000);
-    Serial.println(F("ACK CMD switch to OV2640_1280x1024 END"));
-    temp = 0xff;
-    break;
-    case 8:
-    myCAM.OV2640_set_JPEG_size(OV2640_1600x1200);delay(1000);
-    Serial.println(F("ACK CMD switch to OV2640_1600x1200 END"));
-     temp = 0xff;
-    break;
     case 0x10:
     mode = 1;
     temp = 0xff;
@@ -177,6 +175,7 @@ if (Serial.available())
     temp = 0xff;
     myCAM.set_format(JPEG);
     myCAM.InitCAM();
+    settings.invalidate();
     #if !(defined (OV2640_MINI_2MP))
     myCAM.set_bit(ARDUCHIP_TIM, VSYNC_LEVEL_MASK);
     #endif
@@ -197,260 +196,117 @@ if (Serial.available())
     temp = 0xff;
     myCAM.set_format(BMP);
     myCAM.InitCAM();
+    settings.invalidate();
     #if !(defined (OV2640_MINI_2MP))        
     myCAM.clear_bit(ARDUCHIP_TIM, VSYNC_LEVEL_MASK);
     #endif
     myCAM.wrSensorReg16_8(0x3818, 0x81);
     myCAM.wrSensorReg16_8(0x3621, 0xA7);
     break;
-    case 0x40:
-    myCAM.OV2640_set_Light_Mode(Auto);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Auto END"));break;
-     case 0x41:
-    myCAM.OV2640_set_Light_Mode(Sunny);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Sunny END"));break;
-     case 0x42:
-    myCAM.OV2640_set_Light_Mode(Cloudy);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Cloudy END"));break;
-     case 0x43:
-    myCAM.OV2640_set_Light_Mode(Office);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Office END"));break;
-   case 0x44:
-    myCAM.OV2640_set_Light_Mode(Home);   temp = 0xff;
-   Serial.println(F("ACK CMD Set to Home END"));break;
-   case 0x50:
-    myCAM.OV2640_set_Color_Saturation(Saturation2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+2 END"));break;
-   case 0x51:
-     myCAM.OV2640_set_Color_Saturation(Saturation1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+1 END"));break;
-   case 0x52:
-    myCAM.OV2640_set_Color_Saturation(Saturation0); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+0 END"));break;
-    case 0x53:
-    myCAM. OV2640_set_Color_Saturation(Saturation_1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation-1 END"));break;
-    case 0x54:
-     myCAM.OV2640_set_Color_Saturation(Saturation_2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation-2 END"));break; 
-   case 0x60:
-    myCAM.OV2640_set_Brightness(Brightness2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+2 END"));break;
-   case 0x61:
-     myCAM.OV2640_set_Brightness(Brightness1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+1 END"));break;
-   case 0x62:
-    myCAM.OV2640_set_Brightness(Brightness0); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+0 END"));break;
-    case 0x63:
-    myCAM. OV2640_set_Brightness(Brightness_1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness-1 END"));break;
-    case 0x64:
-     myCAM.OV2640_set_Brightness(Brightness_2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness-2 END"));break; 
-    case 0x70:
-      myCAM.OV2640_set_Contrast(Contrast2);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+2 END"));break; 
-    case 0x71:
-      myCAM.OV2640_set_Contrast(Contrast1);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+1 END"));break;
-     case 0x72:
-      myCAM.OV2640_set_Contrast(Contrast0);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+0 END"));break;
-    case 0x73:
-      myCAM.OV2640_set_Contrast(Contrast_1);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast-1 END"));break;
-   case 0x74:
-      myCAM.OV2640_set_Contrast(Contrast_2);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast-2 END"));break;
-   case 0x80:
-    myCAM.OV2640_set_Special_effects(Antique);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Antique END"));break;
-   case 0x81:
-    myCAM.OV2640_set_Special_effects(Bluish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Bluish END"));break;
-   case 0x82:
-    myCAM.OV2640_set_Special_effects(Greenish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Greenish END"));break;  
-   case 0x83:
-    myCAM.OV2640_set_Special_effects(Reddish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Reddish END"));break;  
-   case 0x84:
-    myCAM.OV2640_set_Special_effects(BW);temp = 0xff;
-    Serial.println(F("ACK CMD Set to BW END"));break; 
-  case 0x85:
-    myCAM.OV2640_set_Special_effects(Negative);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Negative END"));break; 
-  case 0x86:
-    myCAM.OV2640_set_Special_effects(BWnegative);temp = 0xff;
-    Serial.println(F("ACK CMD Set to BWnegative END"));break;   
-   case 0x87:
-    myCAM.OV2640_set_Special_effects(Normal);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Normal END"));break;     
+    case 0x32:
+    //BMP window: x, y, width, height (16-bit little-endian), step, flags (bit 0: gray)
+    temp = 0xff;
+    set_bmp_window();
+    break;
+    default:
+    //0x40..0x87: image settings, 0x90..: profiles, see camera_commands.h
+    commands.push(temp);
+    temp = 0xff;
+    break;
   }
 }
+//Outside video streaming settings take effect right away
+if (mode != 2)
+  commands.apply(settings, Serial);
 if (mode == 1)
 {
   if (start_capture == 1)
   {
-    myCAM.flush_fifo();
-    myCAM.clear_fifo_flag();
     //Start capture
-    myCAM.start_capture();
+    camera.trigger();
     start_capture = 0;
   }
   if (myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK))
   {
+    //Still at the old size after a size change: capture again
+    if (settings.discardFrame())
+    {
+      camera.trigger();
+      return;
+    }
     Serial.println(F("ACK CMD CAM Capture Done. END"));delay(50);
-    read_fifo_burst(myCAM);
+    read_fifo_burst();
     //Clear the capture done flag
     myCAM.clear_fifo_flag();
   }
 }
 else if (mode == 2)
 {
+  fpsSince = millis();
+  fpsFrames = 0;
+  fpsAfterPending = false;
   while (1)
   {
-    temp = Serial.read();
-    if (temp == 0x21)
+    //Drain the host bytes without waiting; setting commands are queued
+    bool stop = false;
+    while (Serial.available())
+    {
+      temp = Serial.read();
+      if (temp == 0x21)
+      {
+        stop = true;
+        break;
+      }
+      bool burst = commands.empty();
+      if (commands.push(temp) && burst)
+        report_fps("before");
+    }
+    if (stop)
     {
       start_capture = 0;
       mode = 0;
       Serial.println(F("ACK CMD CAM stop video streaming. END"));
       break;
     }
-    switch (temp)
-    {
-       case 0x40:
-    myCAM.OV2640_set_Light_Mode(Auto);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Auto END"));break;
-     case 0x41:
-    myCAM.OV2640_set_Light_Mode(Sunny);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Sunny END"));break;
-     case 0x42:
-    myCAM.OV2640_set_Light_Mode(Cloudy);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Cloudy END"));break;
-     case 0x43:
-    myCAM.OV2640_set_Light_Mode(Office);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Office END"));break;
-   case 0x44:
-    myCAM.OV2640_set_Light_Mode(Home);   temp = 0xff;
-   Serial.println(F("ACK CMD Set to Home END"));break;
-   case 0x50:
-    myCAM.OV2640_set_Color_Saturation(Saturation2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+2 END"));break;
-   case 0x51:
-     myCAM.OV2640_set_Color_Saturation(Saturation1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+1 END"));break;
-   case 0x52:
-    myCAM.OV2640_set_Color_Saturation(Saturation0); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation+0 END"));break;
-    case 0x53:
-    myCAM. OV2640_set_Color_Saturation(Saturation_1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation-1 END"));break;
-    case 0x54:
-     myCAM.OV2640_set_Color_Saturation(Saturation_2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Saturation-2 END"));break; 
-   case 0x60:
-    myCAM.OV2640_set_Brightness(Brightness2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+2 END"));break;
-   case 0x61:
-     myCAM.OV2640_set_Brightness(Brightness1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+1 END"));break;
-   case 0x62:
-    myCAM.OV2640_set_Brightness(Brightness0); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness+0 END"));break;
-    case 0x63:
-    myCAM. OV2640_set_Brightness(Brightness_1); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness-1 END"));break;
-    case 0x64:
-     myCAM.OV2640_set_Brightness(Brightness_2); temp = 0xff;
-     Serial.println(F("ACK CMD Set to Brightness-2 END"));break; 
-    case 0x70:
-      myCAM.OV2640_set_Contrast(Contrast2);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+2 END"));break; 
-    case 0x71:
-      myCAM.OV2640_set_Contrast(Contrast1);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+1 END"));break;
-     case 0x72:
-      myCAM.OV2640_set_Contrast(Contrast0);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast+0 END"));break;
-    case 0x73:
-      myCAM.OV2640_set_Contrast(Contrast_1);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast-1 END"));break;
-   case 0x74:
-      myCAM.OV2640_set_Contrast(Contrast_2);temp = 0xff;
-     Serial.println(F("ACK CMD Set to Contrast-2 END"));break;
-   case 0x80:
-    myCAM.OV2640_set_Special_effects(Antique);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Antique END"));break;
-   case 0x81:
-    myCAM.OV2640_set_Special_effects(Bluish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Bluish END"));break;
-   case 0x82:
-    myCAM.OV2640_set_Special_effects(Greenish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Greenish END"));break;  
-   case 0x83:
-    myCAM.OV2640_set_Special_effects(Reddish);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Reddish END"));break;  
-   case 0x84:
-    myCAM.OV2640_set_Special_effects(BW);temp = 0xff;
-    Serial.println(F("ACK CMD Set to BW END"));break; 
-  case 0x85:
-    myCAM.OV2640_set_Special_effects(Negative);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Negative END"));break; 
-  case 0x86:
-    myCAM.OV2640_set_Special_effects(BWnegative);temp = 0xff;
-    Serial.println(F("ACK CMD Set to BWnegative END"));break;   
-   case 0x87:
-    myCAM.OV2640_set_Special_effects(Normal);temp = 0xff;
-    Serial.println(F("ACK CMD Set to Normal END"));break;     
-  }
     if (start_capture == 2)
     {
-      myCAM.flush_fifo();
-      myCAM.clear_fifo_flag();
+      //Frame boundary: the sensor is idle, so queued settings cannot tear a frame
+      if (!commands.empty())
+      {
+        commands.apply(settings, Serial);
+        fpsSince = millis();
+        fpsFrames = 0;
+        fpsAfterPending = true;
+      }
       //Start capture
-      myCAM.start_capture();
+      camera.trigger();
       start_capture = 0;
     }
     if (myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK))
     {
-      uint32_t length = 0;
-      length = myCAM.read_fifo_length();
-      if ((length >= MAX_FIFO_SIZE) | (length == 0))
+      //Drop frames still at the old size, and empty, oversized, invalid or truncated ones
+      if (settings.discardFrame() || camera.finish() != CAPTURE_OK || camera.frame() != CAPTURE_OK)
       {
-        myCAM.clear_fifo_flag();
+        camera.release();
         start_capture = 2;
         continue;
       }
-      myCAM.CS_LOW();
-      myCAM.set_fifo_burst();//Set fifo burst mode
-      temp =  SPI.transfer(0x00);
-      length --;
-      while ( length-- )
+      Serial.println(F("ACK IMG END"));
+#if SERIAL_SINK_MEASURE
+      sink.beginMeasure();
+#endif
+      camera.send(sink);
+      camera.release();
+#if SERIAL_SINK_MEASURE
+      sink.report(Serial, "ACK CMD ", " END");
+#endif
+      fpsFrames++;
+      if (fpsAfterPending && fpsFrames >= FPS_AFTER_FRAMES)
       {
-        temp_last = temp;
-        temp =  SPI.transfer(0x00);
-        if (is_header == true)
-        {
-          Serial.write(temp);
-        }
-        else if ((temp == 0xD8) & (temp_last == 0xFF))
-        {
-          is_header = true;
-          Serial.println(F("ACK IMG END"));
-          Serial.write(temp_last);
-          Serial.write(temp);
-        }
-        if ( (temp == 0xD9) && (temp_last == 0xFF) ) //If find the end ,break while,
-        break;
-        delayMicroseconds(15);
+        report_fps("after");
+        fpsAfterPending = false;
       }
-      myCAM.CS_HIGH();
-      myCAM.clear_fifo_flag();
       start_capture = 2;
-      is_header = false;
     }
   }
 }
@@ -459,103 +315,99 @@ else if (mode == 3)
   if (start_capture == 3)
   {
     //Flush the FIFO
-    myCAM.flush_fifo();
-    myCAM.clear_fifo_flag();
     //Start capture
-    myCAM.start_capture();
+    camera.trigger();
     start_capture = 0;
   }
   if (myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK))
   {
     Serial.println(F("ACK CMD CAM Capture Done. END"));delay(50);
-    uint8_t temp, temp_last;
-    uint32_t length = 0;
-    length = myCAM.read_fifo_length();
-    if (length >= MAX_FIFO_SIZE ) 
+    CaptureResult result = camera.finish();
+    if (result == CAPTURE_TOO_LARGE)
     {
       Serial.println(F("ACK CMD Over size. END"));
-      myCAM.clear_fifo_flag();
+      camera.release();
       return;
     }
-    if (length == 0 ) //0 kb
+    if (result == CAPTURE_EMPTY) //0 kb
     {
       Serial.println(F("ACK CMD Size is 0. END"));
-      myCAM.clear_fifo_flag();
+      camera.release();
       return;
     }
-    myCAM.CS_LOW();
-    myCAM.set_fifo_burst();//Set fifo burst mode
-    
-    Serial.write(0xFF);
-    Serial.write(0xAA);
-    for (temp = 0; temp < BMPIMAGEOFFSET; temp++)
-    {
-      Serial.write(pgm_read_byte(&bmp_header[temp]));
-    }
-    //for old version, enable it else disable
-   // SPI.transfer(0x00);
-    char VH, VL;
-    int i = 0, j = 0;
-    for (i = 0; i < 240; i++)
-    {
-      for (j = 0; j < 320; j++)
-      {
-        VH = SPI.transfer(0x00);;
-        VL = SPI.transfer(0x00);;
-        Serial.write(VL);
-        delayMicroseconds(12);
-        Serial.write(VH);
-        delayMicroseconds(12);
-      }
-    }
-    Serial.write(0xBB);
-    Serial.write(0xCC);
-    myCAM.CS_HIGH();
+    //for old version, the FIFO starts with a dummy byte: add 1 to the offset
+#if SERIAL_SINK_MEASURE
+    sink.beginMeasure();
+#endif
+    BmpRowSink bmp(sink, 320, 240, bmpWindow);
+    camera.sendRange(bmp, bmp.fifoOffset(), bmp.fifoLength());
+#if SERIAL_SINK_MEASURE
+    sink.report(Serial, "ACK CMD ", " END");
+#endif
     //Clear the capture done flag
     myCAM.clear_fifo_flag();
   }
 }
 }
-uint8_t read_fifo_burst(ArduCAM myCAM)
+uint8_t read_fifo_burst()
 {
-  uint8_t temp = 0, temp_last = 0;
-  uint32_t length = 0;
-  length = myCAM.read_fifo_length();
-  Serial.println(length, DEC);
-  if (length >= MAX_FIFO_SIZE) //512 kb
+  CaptureResult result = camera.finish();
+  if (result == CAPTURE_TOO_LARGE) //512 kb
   {
     Serial.println(F("ACK CMD Over size. END"));
     return 0;
   }
-  if (length == 0 ) //0 kb
+  if (result == CAPTURE_EMPTY) //0 kb
   {
     Serial.println(F("ACK CMD Size is 0. END"));
     return 0;
   }
-  myCAM.CS_LOW();
-  myCAM.set_fifo_burst();//Set fifo burst mode
-  temp =  SPI.transfer(0x00);
-  length --;
-  while ( length-- )
+  //Find the exact JPEG (SOI..EOI) before sending it
+  if (camera.frame() != CAPTURE_OK)
   {
-    temp_last = temp;
-    temp =  SPI.transfer(0x00);
-    if (is_header == true)
-    {
-      Serial.write(temp);
-    }
-    else if ((temp == 0xD8) & (temp_last == 0xFF))
-    {
-      is_header = true;
-      Serial.println(F("ACK IMG END"));
-      Serial.write(temp_last);
-      Serial.write(temp);
-    }
-    if ( (temp == 0xD9) && (temp_last == 0xFF) ) //If find the end ,break while,
-    break;
-    delayMicroseconds(15);
+    Serial.println(F("ACK CMD Invalid frame dropped. END"));
+    return 0;
   }
-  myCAM.CS_HIGH();
-  is_header = false;
+  Serial.println(camera.length(), DEC);
+  Serial.println(F("ACK IMG END"));
+#if SERIAL_SINK_MEASURE
+  sink.beginMeasure();
+#endif
+  camera.send(sink);
+#if SERIAL_SINK_MEASURE
+  sink.report(Serial, "ACK CMD ", " END");
+#endif
   return 1;
 }
+void set_bmp_window()
+{
+  uint8_t b[10];
+  if (Serial.readBytes(b, sizeof(b)) != sizeof(b))
+  {
+    Serial.println(F("ACK CMD BMP window needs 10 bytes. END"));
+    return;
+  }
+  RowWindow w;
+  w.x = b[0] | (b[1] << 8);
+  w.y = b[2] | (b[3] << 8);
+  w.width = b[4] | (b[5] << 8);
+  w.height = b[6] | (b[7] << 8);
+  w.step = b[8];
+  w.gray = b[9] & 0x01;
+  //Report the window as clipped to the frame
+  BmpRowSink bmp(sink, 320, 240, w);
+  bmpWindow = bmp.window();
+  Serial.print(F("ACK CMD BMP window "));
+  Serial.print(bmpWindow.x);
+  Serial.print(',');
+  Serial.print(bmpWindow.y);
+  Serial.print(' ');
+  Serial.print(bmpWindow.width);
+  Serial.print('x');
+  Serial.print(bmpWindow.height);
+  Serial.print(F(" step "));
+  Serial.print(bmpWindow.step);
+  Serial.print(bmpWindow.gray ? F(" gray, ") : F(" rgb565, "));
+  Serial.print(bmp.bmpSize());
+  Serial.println(F(" bytes END"));
+}
@@ -1,10 +1,16 @@
 // Capture a single small JPEG from an OV2640 every minute and write to Serial.
+// Frames are sent as binary serial_frame.h frames (header + JPEG, CRC-checked);
+// tools/frame_receiver.cpp receives them on the host.
 // SPI CS pin is 10
 
 #include <Wire.h>
 #include <SPI.h>
 #include <ArduCAM.h>
 #include "memorysaver.h"
+#include "camera_pipeline.h"
+#include "serial_frame.h"
+#include "serial_sink.h"
+#include "scene_change.h"
 
 #if !(defined OV2640_MINI_2MP)
 #error Please enable OV2640_MINI_2MP in memorysaver.h
@@ -12,12 +18,19 @@
 
 const int SPI_CS = 10;
 ArduCAM myCAM(OV2640, SPI_CS);
-const uint32_t MAX_FIFO = 0x7FFFF;
 const unsigned long CAPTURE_INTERVAL = 60000; // 60 seconds
+CameraPipeline camera(myCAM); // capture, JPEG framing and FIFO read-out
+const uint32_t SERIAL_BAUD = 921600;
+SerialSink sink(Serial, SERIAL_BAUD); // block writes, waits only when the TX buffer is full
+// Set to 1 to print "SINK <bytes> B in <ms> ms = <B/s> ..." after each frame.
+#define SERIAL_SINK_MEASURE 0
+uint32_t frameSeq = 0; // serial frame sequence number; gaps on the host mean lost frames
+// Skip frames whose JPEG size is within 2% of the last one sent, but send at least every 15 minutes.
+SceneChangeDetector sceneDetector(20, 15UL * 60000);
 
 void setup() {
   Wire.begin();
-  Serial.begin(921600);
+  Serial.begin(SERIAL_BAUD);
   pinMode(SPI_CS, OUTPUT); digitalWrite(SPI_CS, HIGH);
   SPI.begin();
 
@@ -44,46 +57,35 @@ void setup() {
 static unsigned long lastCapture = 0;
 
 void captureOnce() {
-  // Prepare and trigger capture
-  myCAM.flush_fifo();
-  myCAM.clear_fifo_flag();
-  myCAM.start_capture();
-
-  unsigned long t0 = millis();
-  while (!myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
-    if (millis() - t0 > 2000) break; // timeout
+  // Capture and find the exact JPEG (SOI..EOI) before announcing it; drop invalid frames.
+  CaptureResult r = camera.capture();
+  if (r != CAPTURE_OK) {
+    camera.release();
+    if (r == CAPTURE_INVALID) { Serial.print("CAP_DROP "); Serial.println(camera.framer().dropped()); }
+    else Serial.println("Capture failed or too large");
+    return;
   }
+  uint32_t jpegLen = camera.length();
 
-  uint32_t len = myCAM.read_fifo_length();
-  if (len == 0 || len >= MAX_FIFO) { myCAM.clear_fifo_flag(); Serial.println("Capture failed or too large"); return; }
-
-  // Announce capture start (text). Serial listeners should detect SOI (0xFFD8).
-  Serial.print("CAP_START "); Serial.println(len);
-
-  // Burst read and stream JPEG bytes
-  myCAM.CS_LOW();
-  myCAM.set_fifo_burst();
-  uint8_t prev = 0, cur = 0;
-  cur = SPI.transfer(0x00); // prime
-  if (len) len--;
-  bool started = false;
-  while (len--) {
-    prev = cur; cur = SPI.transfer(0x00);
-    if (started) {
-      Serial.write(cur);
-    } else if (prev == 0xFF && cur == 0xD8) {
-      // SOI
-      started = true;
-      Serial.write((uint8_t)0xFF); Serial.write((uint8_t)0xD8);
-    }
-    if (started && prev == 0xFF && cur == 0xD9) break; // EOI
-    delayMicroseconds(15);
+  if (!sceneDetector.changed(jpegLen, camera.startedAt())) {
+    camera.release();
+    Serial.print("CAP_UNCHANGED "); Serial.println(sceneDetector.unchanged());
+    return;
   }
-  myCAM.CS_HIGH();
-  myCAM.clear_fifo_flag();
 
-  Serial.println();
-  Serial.println("CAP_DONE");
+  // Binary header with the exact length and CRC, so the host can verify the frame.
+  SerialFrameHeader h = {frameSeq++, camera.startedAt(), jpegLen, camera.crc()};
+  uint8_t header[SERIAL_FRAME_HEADER_SIZE];
+  serialFrameEncode(header, h);
+#if SERIAL_SINK_MEASURE
+  sink.beginMeasure();
+#endif
+  sink.write(header, sizeof(header));
+  camera.send(sink);
+  camera.release();
+#if SERIAL_SINK_MEASURE
+  sink.report(Serial, "SINK ");
+#endif
 }
 
 void loop() {
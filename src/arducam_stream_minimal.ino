@@ -1,10 +1,14 @@
 // Minimal ArduCAM OV2640 streaming sketch
-// Streams single JPEG frames over Serial continuously.
+// Streams single JPEG frames over Serial continuously, each wrapped in a
+// serial_frame.h header (length + CRC-32) for tools/frame_receiver.cpp.
 
 #include <Wire.h>
 #include <SPI.h>
 #include <ArduCAM.h>
 #include "memorysaver.h"
+#include "camera_pipeline.h"
+#include "serial_frame.h"
+#include "serial_sink.h"
 
 #if !(defined OV2640_MINI_2MP)
 #error Please enable OV2640_MINI_2MP in memorysaver.h
@@ -12,11 +16,16 @@
 
 const int CS = 7;
 ArduCAM myCAM(OV2640, CS);
-const uint32_t MAX_FIFO = 0x7FFFF;
+CameraPipeline camera(myCAM); // capture, JPEG framing and FIFO read-out
+const uint32_t SERIAL_BAUD = 921600;
+SerialSink sink(Serial, SERIAL_BAUD); // block writes, waits only when the TX buffer is full
+// Set to 1 to print "SINK <bytes> B in <ms> ms = <B/s> ..." after each frame.
+#define SERIAL_SINK_MEASURE 0
+uint32_t frameSeq = 0; // serial frame sequence number
 
 void setup() {
   Wire.begin();
-  Serial.begin(921600);
+  Serial.begin(SERIAL_BAUD);
   pinMode(CS, OUTPUT); digitalWrite(CS, HIGH);
   SPI.begin();
 
@@ -34,35 +43,20 @@ void setup() {
 }
 
 void loop() {
-  myCAM.flush_fifo();
-  myCAM.clear_fifo_flag();
-  myCAM.start_capture();
-
-  unsigned long t0 = millis();
-  while (!myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK)) {
-    if (millis() - t0 > 2000) break; // capture timeout
-  }
-
-  uint32_t len = myCAM.read_fifo_length();
-  if (len == 0 || len >= MAX_FIFO) { myCAM.clear_fifo_flag(); delay(100); return; }
-
-  myCAM.CS_LOW();
-  myCAM.set_fifo_burst();
-
-  uint8_t prev = 0, cur = 0;
-  cur = SPI.transfer(0x00); // prime
-  len--;
-  bool started = false;
-  while (len--) {
-    prev = cur; cur = SPI.transfer(0x00);
-    if (started) Serial.write(cur);
-    else if (prev == 0xFF && cur == 0xD8) { // SOI
-      started = true; Serial.write(0xFF); Serial.write(0xD8);
-    }
-    if (started && prev == 0xFF && cur == 0xD9) break; // EOI
-  }
-
-  myCAM.CS_HIGH();
-  myCAM.clear_fifo_flag();
+  // Find the exact JPEG (SOI..EOI) first; empty, oversized, invalid or truncated frames are dropped.
+  if (camera.capture() != CAPTURE_OK) { camera.release(); delay(100); return; }
+
+  SerialFrameHeader h = {frameSeq++, camera.startedAt(), camera.length(), camera.crc()};
+  uint8_t header[SERIAL_FRAME_HEADER_SIZE];
+  serialFrameEncode(header, h);
+#if SERIAL_SINK_MEASURE
+  sink.beginMeasure();
+#endif
+  sink.write(header, sizeof(header));
+  camera.send(sink);
+  camera.release();
+#if SERIAL_SINK_MEASURE
+  sink.report(Serial, "SINK ");
+#endif
   delay(100); // small pause between frames
 }
@@ -0,0 +1,47 @@
+/**
+ * @file base64.h
+ * @brief Minimal Base64 encoder (RFC 4648) for HTTP authentication headers.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Encode `len` bytes from `in` into `out` as NUL-terminated Base64.
+ *
+ * `out` must hold at least `base64EncodedLength(len) + 1` bytes.
+ * Returns the number of characters written (excluding the terminator).
+ */
+inline size_t base64Encode(const uint8_t *in, size_t len, char *out)
+{
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3)
+    {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        out[o++] = ALPHABET[(v >> 18) & 0x3F];
+        out[o++] = ALPHABET[(v >> 12) & 0x3F];
+        out[o++] = ALPHABET[(v >> 6) & 0x3F];
+        out[o++] = ALPHABET[v & 0x3F];
+    }
+    if (i < len)
+    {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)in[i + 1] << 8;
+        out[o++] = ALPHABET[(v >> 18) & 0x3F];
+        out[o++] = ALPHABET[(v >> 12) & 0x3F];
+        out[o++] = (i + 1 < len) ? ALPHABET[(v >> 6) & 0x3F] : '=';
+        out[o++] = '=';
+    }
+    out[o] = '\0';
+    return o;
+}
+
+/** Encoded length (without terminator) of `len` input bytes. */
+inline size_t base64EncodedLength(size_t len)
+{
+    return ((len + 2) / 3) * 4;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file bmp_rows.h
+ * @brief Row-by-row RGB565 read-out with crop, decimation and grayscale.
+ *
+ * In BMP mode the ArduCAM FIFO holds a raw RGB565 frame, high byte first,
+ * one scanline after another. BmpRowSink consumes that stream through the
+ * camera pipeline and rebuilds it one scanline at a time: only the rows and
+ * pixels inside a window (region of interest, every `step`-th pixel in both
+ * directions) are kept, optionally converted to 8-bit luma, and each output
+ * row is written as soon as it is complete. Only the window's rows are read
+ * from the FIFO.
+ *
+ * The output is a BMP framed as the ArduCAM host protocol expects
+ * (0xFF 0xAA, BMP, 0xBB 0xCC): 16-bit RGB565 with bit-field masks, or
+ * 8-bit with a gray palette. Rows keep the sensor's top-to-bottom order
+ * with a positive height, as the original full-frame header did.
+ *
+ * Bytes shipped for a 320x240 frame (153600 B of pixels):
+ *   full frame, step 2, gray      19200 B   (8x)
+ *   160x120 window, step 2, gray   4800 B   (32x)
+ *
+ * Usage:
+ *   BmpRowSink bmp(sink, 320, 240, window);
+ *   camera.sendRange(bmp, bmp.fifoOffset(), bmp.fifoLength());
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "camera_pipeline.h"
+
+/** Largest sensor row handled (OV2640 BMP mode is 320x240). */
+#ifndef BMP_ROW_MAX_WIDTH
+#define BMP_ROW_MAX_WIDTH 320
+#endif
+
+/** Part of the frame to ship. Coordinates are in sensor pixels. */
+struct RowWindow
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t step; ///< Keep every step-th pixel and row (1 = no decimation)
+    bool gray;    ///< Ship 8-bit luma instead of RGB565
+};
+
+class BmpRowSink : public FrameSink
+{
+public:
+    /** BMP file header + info header + RGB565 bit-field masks. */
+    static const uint16_t HEADER_RGB565 = 14 + 40 + 12;
+    /** BMP file header + info header + 256-entry gray palette. */
+    static const uint16_t HEADER_GRAY = 14 + 40 + 256 * 4;
+
+    /**
+     * @param out         Where the framed BMP is written
+     * @param frameWidth  Sensor row width in pixels
+     * @param frameHeight Sensor row count
+     * @param window      Region to ship; clipped to the frame
+     */
+    BmpRowSink(FrameSink &out, uint16_t frameWidth, uint16_t frameHeight, const RowWindow &window)
+        : _out(out), _frameWidth(frameWidth), _win(window)
+    {
+        if (_frameWidth > BMP_ROW_MAX_WIDTH)
+            _frameWidth = BMP_ROW_MAX_WIDTH;
+        if (_win.step == 0)
+            _win.step = 1;
+        if (_win.x >= _frameWidth)
+            _win.x = 0;
+        if (_win.y >= frameHeight)
+            _win.y = 0;
+        if (_win.width == 0 || _win.x + _win.width > _frameWidth)
+            _win.width = _frameWidth - _win.x;
+        if (_win.height == 0 || _win.y + _win.height > frameHeight)
+            _win.height = frameHeight - _win.y;
+        _outWidth = (_win.width + _win.step - 1) / _win.step;
+        _outHeight = (_win.height + _win.step - 1) / _win.step;
+        _stride = ((uint32_t)_outWidth * (_win.gray ? 8 : 16) + 31) / 32 * 4;
+    }
+
+    /** The window after clipping. */
+    const RowWindow &window() const { return _win; }
+    uint16_t outWidth() const { return _outWidth; }
+    uint16_t outHeight() const { return _outHeight; }
+
+    /** FIFO range holding the window's rows; pass both to `CameraPipeline::sendRange()`. */
+    uint32_t fifoOffset() const { return (uint32_t)_win.y * _frameWidth * 2; }
+    uint32_t fifoLength() const { return (uint32_t)_win.height * _frameWidth * 2; }
+
+    /** BMP bytes written between the 0xFF 0xAA / 0xBB 0xCC markers. */
+    uint32_t bmpSize() const { return headerSize() + (uint32_t)_stride * _outHeight; }
+
+    void begin(uint32_t length) override
+    {
+        _x = 0;
+        _row = 0;
+        _fill = 0;
+        _ok = true;
+        const uint8_t start[2] = {0xFF, 0xAA};
+        put(start, 2);
+        writeHeader();
+    }
+
+    bool write(uint8_t *buf, size_t n) override
+    {
+        // Blocks are CAM_BURST_CHUNK bytes (even), so a pixel never straddles two.
+        size_t i = 0;
+        while (i + 1 < n && _ok)
+        {
+            if (_row % _win.step)
+            {
+                // Decimated row: skip what is left of it in this block.
+                size_t left = (size_t)(_frameWidth - _x) * 2;
+                size_t k = (n - i < left) ? n - i : left;
+                i += k;
+                advance(k / 2);
+                continue;
+            }
+            uint16_t dx = _x - _win.x;
+            if (_x >= _win.x && _x < _win.x + _win.width && dx % _win.step == 0)
+                pixel(buf[i], buf[i + 1]);
+            i += 2;
+            advance(1);
+        }
+        return _ok;
+    }
+
+    void end(bool complete) override
+    {
+        const uint8_t stop[2] = {0xBB, 0xCC};
+        put(stop, 2);
+    }
+
+private:
+    uint16_t headerSize() const { return _win.gray ? HEADER_GRAY : HEADER_RGB565; }
+
+    /** Store one kept pixel (RGB565, high byte first) in the output row. */
+    void pixel(uint8_t hi, uint8_t lo)
+    {
+        if (_win.gray)
+        {
+            uint8_t r = hi & 0xF8;
+            uint8_t g = ((hi & 0x07) << 5) | ((lo & 0xE0) >> 3);
+            uint8_t b = lo << 3;
+            // BT.601 luma in fixed point; weights sum to 256.
+            _rowBuf[_fill++] = (77 * r + 150 * g + 29 * b) >> 8;
+        }
+        else
+        {
+            // BMP stores the 16-bit pixel little-endian.
+            _rowBuf[_fill++] = lo;
+            _rowBuf[_fill++] = hi;
+        }
+    }
+
+    /** Move past `n` sensor pixels; write the output row at the end of a kept row. */
+    void advance(uint16_t n)
+    {
+        _x += n;
+        if (_x < _frameWidth)
+            return;
+        if (_row % _win.step == 0)
+        {
+            while (_fill < _stride)
+                _rowBuf[_fill++] = 0;
+            put(_rowBuf, _stride);
+        }
+        _fill = 0;
+        _x = 0;
+        _row++;
+    }
+
+    void put(const uint8_t *data, size_t n)
+    {
+        // Sinks take a mutable buffer; the row buffer and headers are ours to lend.
+        if (_ok && !_out.write(const_cast<uint8_t *>(data), n))
+            _ok = false;
+    }
+
+    static void le16(uint8_t *p, uint16_t v)
+    {
+        p[0] = v;
+        p[1] = v >> 8;
+    }
+
+    static void le32(uint8_t *p, uint32_t v)
+    {
+        le16(p, v);
+        le16(p + 2, v >> 16);
+    }
+
+    void writeHeader()
+    {
+        uint8_t h[HEADER_RGB565];
+        memset(h, 0, sizeof(h));
+        uint32_t image = (uint32_t)_stride * _outHeight;
+        h[0] = 'B';
+        h[1] = 'M';
+        le32(h + 2, bmpSize());
+        le32(h + 10, headerSize());
+        le32(h + 14, 40);
+        le32(h + 18, _outWidth);
+        le32(h + 22, _outHeight);
+        le16(h + 26, 1);
+        le16(h + 28, _win.gray ? 8 : 16);
+        le32(h + 30, _win.gray ? 0 : 3); // BI_RGB / BI_BITFIELDS
+        le32(h + 34, image);
+        le32(h + 38, 0x0EC4);
+        le32(h + 42, 0x0EC4);
+        if (_win.gray)
+        {
+            put(h, 54);
+            for (uint16_t v = 0; v < 256; ++v)
+            {
+                uint8_t entry[4] = {(uint8_t)v, (uint8_t)v, (uint8_t)v, 0};
+                put(entry, 4);
+            }
+            return;
+        }
+        le32(h + 54, 0xF800);
+        le32(h + 58, 0x07E0);
+        le32(h + 62, 0x001F);
+        put(h, HEADER_RGB565);
+    }
+
+    FrameSink &_out;
+    uint16_t _frameWidth;
+    RowWindow _win;
+    uint16_t _outWidth;
+    uint16_t _outHeight;
+    uint16_t _stride; ///< Output row bytes, padded to 4 as BMP requires
+    uint16_t _x;      ///< Next sensor pixel in the current row
+    uint16_t _row;    ///< Current row relative to the window top
+    uint16_t _fill;   ///< Bytes in _rowBuf
+    bool _ok;
+    uint8_t _rowBuf[BMP_ROW_MAX_WIDTH * 2];
+};
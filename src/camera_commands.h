@@ -0,0 +1,298 @@
+/**
+ * @file camera_commands.h
+ * @brief OV2640 image setting commands and profiles of the ArduCAM host protocol.
+ *
+ * Commands 0x40..0x87 (light mode, saturation, brightness, contrast and
+ * special effect) are one table instead of a switch per call site. Each
+ * entry names the setting it changes, the value passed to the ArduCAM
+ * library and the label acknowledged to the host.
+ *
+ * Named profiles (0x90 + index) bundle a JPEG size and one value per
+ * setting for typical conditions, e.g. "dawn", "midday" and "inspection".
+ *
+ * CameraSettings shadows what the sensor currently holds. Each setting
+ * call is a burst of SCCB register writes, so only settings that differ
+ * from the shadow are written: a profile switch costs the changed settings
+ * only, and nothing when it is already active. After a size change the
+ * sensor's next frame is still at the old size, so it is discarded
+ * (`discardFrame()`) instead of waiting a fixed second.
+ *
+ * CameraCommandQueue holds received commands until the caller reaches a
+ * frame boundary, so sensor registers are never written while a frame is
+ * being captured. A newer command for a setting replaces the queued one,
+ * so a burst (e.g. a slider dragged in the host app) costs one register
+ * write per setting.
+ *
+ * Usage:
+ *   if (commands.push(byteFromHost)) { ... }   // false: not a setting or profile command
+ *   // between frames:
+ *   commands.apply(settings, Serial);
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduCAM.h>
+
+/** Sensor setting changed by a command. */
+enum CameraSetting
+{
+    SETTING_LIGHT_MODE,
+    SETTING_SATURATION,
+    SETTING_BRIGHTNESS,
+    SETTING_CONTRAST,
+    SETTING_EFFECT,
+    SETTING_COUNT
+};
+
+struct CameraCommand
+{
+    uint8_t code;      ///< Command byte sent by the host
+    uint8_t setting;   ///< CameraSetting
+    uint8_t value;     ///< Argument for the OV2640_set_* call
+    const char *label; ///< Acknowledged as "ACK CMD Set to <label> END"
+};
+
+static const CameraCommand CAMERA_COMMANDS[] = {
+    {0x40, SETTING_LIGHT_MODE, Auto, "Auto"},
+    {0x41, SETTING_LIGHT_MODE, Sunny, "Sunny"},
+    {0x42, SETTING_LIGHT_MODE, Cloudy, "Cloudy"},
+    {0x43, SETTING_LIGHT_MODE, Office, "Office"},
+    {0x44, SETTING_LIGHT_MODE, Home, "Home"},
+    {0x50, SETTING_SATURATION, Saturation2, "Saturation+2"},
+    {0x51, SETTING_SATURATION, Saturation1, "Saturation+1"},
+    {0x52, SETTING_SATURATION, Saturation0, "Saturation+0"},
+    {0x53, SETTING_SATURATION, Saturation_1, "Saturation-1"},
+    {0x54, SETTING_SATURATION, Saturation_2, "Saturation-2"},
+    {0x60, SETTING_BRIGHTNESS, Brightness2, "Brightness+2"},
+    {0x61, SETTING_BRIGHTNESS, Brightness1, "Brightness+1"},
+    {0x62, SETTING_BRIGHTNESS, Brightness0, "Brightness+0"},
+    {0x63, SETTING_BRIGHTNESS, Brightness_1, "Brightness-1"},
+    {0x64, SETTING_BRIGHTNESS, Brightness_2, "Brightness-2"},
+    {0x70, SETTING_CONTRAST, Contrast2, "Contrast+2"},
+    {0x71, SETTING_CONTRAST, Contrast1, "Contrast+1"},
+    {0x72, SETTING_CONTRAST, Contrast0, "Contrast+0"},
+    {0x73, SETTING_CONTRAST, Contrast_1, "Contrast-1"},
+    {0x74, SETTING_CONTRAST, Contrast_2, "Contrast-2"},
+    {0x80, SETTING_EFFECT, Antique, "Antique"},
+    {0x81, SETTING_EFFECT, Bluish, "Bluish"},
+    {0x82, SETTING_EFFECT, Greenish, "Greenish"},
+    {0x83, SETTING_EFFECT, Reddish, "Reddish"},
+    {0x84, SETTING_EFFECT, BW, "BW"},
+    {0x85, SETTING_EFFECT, Negative, "Negative"},
+    {0x86, SETTING_EFFECT, BWnegative, "BWnegative"},
+    {0x87, SETTING_EFFECT, Normal, "Normal"},
+};
+static const uint8_t CAMERA_COMMAND_COUNT = sizeof(CAMERA_COMMANDS) / sizeof(CAMERA_COMMANDS[0]);
+
+/** Table entry for `code`, or nullptr if it is not a setting command. */
+inline const CameraCommand *cameraCommandFind(uint8_t code)
+{
+    for (uint8_t i = 0; i < CAMERA_COMMAND_COUNT; ++i)
+        if (CAMERA_COMMANDS[i].code == code)
+            return &CAMERA_COMMANDS[i];
+    return nullptr;
+}
+
+/** A named set of camera settings. */
+struct CameraProfile
+{
+    uint8_t code;                  ///< Command byte sent by the host
+    const char *name;              ///< Acknowledged as "ACK CMD Profile <name> ... END"
+    uint8_t size;                  ///< OV2640_* JPEG size
+    uint8_t values[SETTING_COUNT]; ///< One value per CameraSetting
+};
+
+static const CameraProfile CAMERA_PROFILES[] = {
+    // Low, warm light: lift brightness and contrast, keep colour.
+    {0x90, "dawn", OV2640_640x480, {Cloudy, Saturation1, Brightness1, Contrast1, Normal}},
+    // Bright overhead sun: neutral settings, daylight white balance.
+    {0x91, "midday", OV2640_640x480, {Sunny, Saturation0, Brightness0, Contrast0, Normal}},
+    // Close look at leaves: full resolution, extra colour and contrast.
+    {0x92, "inspection", OV2640_1600x1200, {Auto, Saturation1, Brightness0, Contrast1, Normal}},
+};
+static const uint8_t CAMERA_PROFILE_COUNT = sizeof(CAMERA_PROFILES) / sizeof(CAMERA_PROFILES[0]);
+
+/** Profile for `code`, or nullptr if it is not a profile command. */
+inline const CameraProfile *cameraProfileFind(uint8_t code)
+{
+    for (uint8_t i = 0; i < CAMERA_PROFILE_COUNT; ++i)
+        if (CAMERA_PROFILES[i].code == code)
+            return &CAMERA_PROFILES[i];
+    return nullptr;
+}
+
+/** Write one setting to the sensor. */
+inline void cameraApplySetting(ArduCAM &cam, uint8_t setting, uint8_t value)
+{
+    switch (setting)
+    {
+    case SETTING_LIGHT_MODE:
+        cam.OV2640_set_Light_Mode(value);
+        break;
+    case SETTING_SATURATION:
+        cam.OV2640_set_Color_Saturation(value);
+        break;
+    case SETTING_BRIGHTNESS:
+        cam.OV2640_set_Brightness(value);
+        break;
+    case SETTING_CONTRAST:
+        cam.OV2640_set_Contrast(value);
+        break;
+    case SETTING_EFFECT:
+        cam.OV2640_set_Special_effects(value);
+        break;
+    }
+}
+
+/**
+ * @brief Shadow of the sensor's settings; writes only what changes.
+ *
+ * Everything starts unknown, so the first call for each setting writes.
+ * Call `invalidate()` after `InitCAM()`, which resets the sensor.
+ */
+class CameraSettings
+{
+public:
+    /** Frames the sensor still delivers at the old size after a size change. */
+    static const uint8_t SIZE_SETTLE_FRAMES = 1;
+
+    explicit CameraSettings(ArduCAM &cam) : _cam(cam), _discard(0) { invalidate(); }
+
+    /** Forget the shadow, e.g. after the sensor was re-initialised. */
+    void invalidate()
+    {
+        _known = 0;
+        _size = 0xFF;
+    }
+
+    /** Write `value` unless the sensor already holds it. Returns true when registers were written. */
+    bool set(uint8_t setting, uint8_t value)
+    {
+        uint8_t bit = 1 << setting;
+        if ((_known & bit) && _values[setting] == value)
+            return false;
+        cameraApplySetting(_cam, setting, value);
+        _values[setting] = value;
+        _known |= bit;
+        return true;
+    }
+
+    /** Change the JPEG size if it differs. Returns true when registers were written. */
+    bool setSize(uint8_t size)
+    {
+        if (size == _size)
+            return false;
+        _cam.OV2640_set_JPEG_size(size);
+        _size = size;
+        _discard = SIZE_SETTLE_FRAMES;
+        return true;
+    }
+
+    /** Apply a profile. Returns the number of settings (including size) written. */
+    uint8_t apply(const CameraProfile &profile)
+    {
+        uint8_t n = setSize(profile.size) ? 1 : 0;
+        for (uint8_t s = 0; s < SETTING_COUNT; ++s)
+            n += set(s, profile.values[s]) ? 1 : 0;
+        return n;
+    }
+
+    /**
+     * @brief Call for each captured frame; true when it must be dropped
+     * because the sensor has not yet switched to the new size.
+     */
+    bool discardFrame()
+    {
+        if (!_discard)
+            return false;
+        _discard--;
+        return true;
+    }
+
+private:
+    ArduCAM &_cam;
+    uint8_t _known; ///< Bit per CameraSetting whose value is in _values
+    uint8_t _values[SETTING_COUNT];
+    uint8_t _size;  ///< 0xFF when unknown
+    uint8_t _discard;
+};
+
+class CameraCommandQueue
+{
+public:
+    CameraCommandQueue() : _profile(nullptr), _count(0) {}
+
+    /**
+     * @brief Queue a command byte. Returns false if it is not a setting or profile command.
+     *
+     * A queued command for the same setting is replaced in place, so the
+     * queue holds at most one entry per setting and never overflows. A
+     * profile replaces everything queued before it.
+     */
+    bool push(uint8_t code)
+    {
+        const CameraProfile *profile = cameraProfileFind(code);
+        if (profile)
+        {
+            _profile = profile;
+            _count = 0;
+            return true;
+        }
+        const CameraCommand *cmd = cameraCommandFind(code);
+        if (!cmd)
+            return false;
+        for (uint8_t i = 0; i < _count; ++i)
+        {
+            if (_pending[i]->setting == cmd->setting)
+            {
+                _pending[i] = cmd;
+                return true;
+            }
+        }
+        _pending[_count++] = cmd;
+        return true;
+    }
+
+    bool empty() const { return !_profile && _count == 0; }
+
+    /**
+     * @brief Apply the queued profile, then the queued settings in arrival
+     * order, and acknowledge each on `ack`.
+     *
+     * Call only between frames. Settings the sensor already holds are not
+     * written. Returns the number of settings written.
+     */
+    uint8_t apply(CameraSettings &settings, Print &ack)
+    {
+        uint8_t written = 0;
+        if (_profile)
+        {
+            unsigned long t0 = micros();
+            uint8_t n = settings.apply(*_profile);
+            unsigned long us = micros() - t0;
+            written += n;
+            ack.print(F("ACK CMD Profile "));
+            ack.print(_profile->name);
+            ack.print(F(": "));
+            ack.print(n);
+            ack.print(F(" settings in "));
+            ack.print(us / 1000);
+            ack.println(F(" ms END"));
+            _profile = nullptr;
+        }
+        for (uint8_t i = 0; i < _count; ++i)
+        {
+            written += settings.set(_pending[i]->setting, _pending[i]->value) ? 1 : 0;
+            ack.print(F("ACK CMD Set to "));
+            ack.print(_pending[i]->label);
+            ack.println(F(" END"));
+        }
+        _count = 0;
+        return written;
+    }
+
+private:
+    const CameraProfile *_profile;
+    const CameraCommand *_pending[SETTING_COUNT];
+    uint8_t _count;
+};
@@ -0,0 +1,319 @@
+/**
+ * @file camera_health.h
+ * @brief Periodic ArduCAM health check and hot recovery, a step per tick.
+ *
+ * A camera that browns out in the field stops answering on SPI or I2C, and
+ * every capture then times out. CameraHealth notices this in two ways:
+ * consecutive empty (timed-out) captures reported by the sketch, and a
+ * cheap periodic probe (the ARDUCHIP_TEST1 0x55 write/read-back on SPI and
+ * the OV2640 chip ID on I2C).
+ *
+ * Recovery repeats what `setup()` and `InitCAM()` do, split into short
+ * steps so the control loop keeps running:
+ *   reset the ArduChip CPLD (two 100 ms waits, not delays)
+ *   probe SPI and the sensor ID
+ *   soft-reset the sensor (100 ms wait)
+ *   write the OV2640 JPEG init tables, a few registers per tick
+ * The last two steps are SensorInit, which CanopyProbe also uses to switch
+ * the sensor between JPEG and RGB565 without a blocking `InitCAM()`.
+ * A failed probe backs off, doubling from RETRY_MIN_MS to RETRY_MAX_MS, so
+ * a missing camera costs one probe every few minutes.
+ *
+ * The sensor comes back at 320x240 JPEG; `tick()` returns true once so the
+ * sketch can re-apply its own size.
+ *
+ * Usage:
+ *   health.begin(detectedInSetup);
+ *   // in the capture state machine, only while the camera is idle:
+ *   if (health.tick()) myCAM.OV2640_set_JPEG_size(size);
+ *   cameraEnabled = health.ok();
+ *   // after each capture:
+ *   health.recordCapture(result != CAPTURE_EMPTY);
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduCAM.h>
+#include <ov2640_regs.h>
+
+/**
+ * @brief `InitCAM()` for the OV2640, a few registers per `step()`.
+ *
+ * `begin()` issues the sensor soft reset and queues the tables `InitCAM()`
+ * writes for the format; `step()` waits RESET_MS for the reset, then writes
+ * REGS_PER_TICK registers per call. More tables (a JPEG size) can be queued
+ * with `add()` before the first step.
+ */
+class SensorInit
+{
+public:
+    /** Sensor soft reset settle time (ms), as in InitCAM(). */
+    static const unsigned long RESET_MS = 100;
+    /** Sensor registers written per step. */
+    static const uint8_t REGS_PER_TICK = 8;
+    static const uint8_t MAX_TABLES = 6;
+
+    explicit SensorInit(ArduCAM &cam) : _cam(cam), _count(0), _table(0), _reg(0), _at(0) {}
+
+    /** Select `format` (JPEG or BMP), soft-reset the sensor and queue its init tables. */
+    void begin(uint8_t format)
+    {
+        // InitCAM() writes 0xff=0x01, 0x15=0x00 between the JPEG and size tables.
+        static const struct sensor_reg BANK_SENSOR[] PROGMEM = {{0xff, 0x01}, {0x15, 0x00}, {0xff, 0xff}};
+        _cam.set_format(format);
+        _cam.wrSensorReg8_8(0xff, 0x01);
+        _cam.wrSensorReg8_8(0x12, 0x80);
+        _at = millis();
+        _count = 0;
+        _table = 0;
+        _reg = 0;
+        if (format == JPEG)
+        {
+            add(OV2640_JPEG_INIT);
+            add(OV2640_YUV422);
+            add(OV2640_JPEG);
+            add(BANK_SENSOR);
+            add(OV2640_320x240_JPEG);
+        }
+        else
+        {
+            add(OV2640_QVGA);
+        }
+    }
+
+    /** Queue one more table, terminated by {0xff, 0xff}. */
+    void add(const struct sensor_reg *table)
+    {
+        if (_count < MAX_TABLES)
+            _tables[_count++] = table;
+    }
+
+    /** Write up to REGS_PER_TICK registers once the reset has settled. Returns true when done. */
+    bool step()
+    {
+        if (millis() - _at < RESET_MS)
+            return false;
+        for (uint8_t n = 0; n < REGS_PER_TICK && _table < _count; ++n)
+        {
+            const struct sensor_reg *entry = _tables[_table] + _reg;
+            uint16_t reg = pgm_read_word(&entry->reg);
+            uint16_t val = pgm_read_word(&entry->val);
+            if (reg == 0xff && val == 0xff)
+            {
+                _table++;
+                _reg = 0;
+                continue;
+            }
+            _cam.wrSensorReg8_8(reg, val);
+            _reg++;
+        }
+        return _table >= _count;
+    }
+
+    /** The table `OV2640_set_JPEG_size(size)` writes. */
+    static const struct sensor_reg *jpegSizeTable(uint8_t size)
+    {
+        switch (size)
+        {
+        case OV2640_160x120:
+            return OV2640_160x120_JPEG;
+        case OV2640_176x144:
+            return OV2640_176x144_JPEG;
+        case OV2640_352x288:
+            return OV2640_352x288_JPEG;
+        case OV2640_640x480:
+            return OV2640_640x480_JPEG;
+        case OV2640_800x600:
+            return OV2640_800x600_JPEG;
+        case OV2640_1024x768:
+            return OV2640_1024x768_JPEG;
+        case OV2640_1280x1024:
+            return OV2640_1280x1024_JPEG;
+        case OV2640_1600x1200:
+            return OV2640_1600x1200_JPEG;
+        default:
+            return OV2640_320x240_JPEG;
+        }
+    }
+
+private:
+    ArduCAM &_cam;
+    const struct sensor_reg *_tables[MAX_TABLES];
+    uint8_t _count;
+    uint8_t _table;
+    uint16_t _reg;
+    unsigned long _at;
+};
+
+class CameraHealth
+{
+public:
+    /** Consecutive empty captures that trigger a recovery. */
+    static const uint8_t FAILURE_LIMIT = 3;
+    /** ArduChip CPLD reset hold/settle time (ms), as in setup(). */
+    static const unsigned long RESET_MS = 100;
+    /** First retry delay after a failed probe, doubled on each failure up to RETRY_MAX_MS. */
+    static const unsigned long RETRY_MIN_MS = 5000;
+    static const unsigned long RETRY_MAX_MS = 300000;
+
+    /**
+     * @param cam             Camera to check
+     * @param checkIntervalMs Time between probes while healthy
+     */
+    explicit CameraHealth(ArduCAM &cam, unsigned long checkIntervalMs = 30000)
+        : _cam(cam), _checkIntervalMs(checkIntervalMs), _state(HEALTH_OK), _at(0), _retryMs(RETRY_MIN_MS),
+          _captureFailures(0), _init(cam), _recoveries(0), _outages(0)
+    {
+    }
+
+    /** Start from the result of the probe in setup(); a missing camera is retried. */
+    void begin(bool detected)
+    {
+        _at = millis();
+        if (detected)
+        {
+            _state = HEALTH_OK;
+            return;
+        }
+        _outages++;
+        _retryMs = RETRY_MIN_MS;
+        _state = HEALTH_BACKOFF;
+    }
+
+    /** Camera usable: not failed and not being recovered. */
+    bool ok() const { return _state == HEALTH_OK; }
+
+    /** "ok", "recovering" or "offline" (waiting to retry after a failed probe). */
+    const char *status() const
+    {
+        if (_state == HEALTH_OK)
+            return "ok";
+        return _state == HEALTH_BACKOFF ? "offline" : "recovering";
+    }
+
+    /** Report a capture outcome; FAILURE_LIMIT empty captures in a row start a recovery. */
+    void recordCapture(bool success)
+    {
+        if (success)
+        {
+            _captureFailures = 0;
+            return;
+        }
+        if (++_captureFailures >= FAILURE_LIMIT && _state == HEALTH_OK)
+            fail();
+    }
+
+    /**
+     * @brief Advance the check or recovery by one short step.
+     *
+     * Call only while no capture or FIFO read is in progress. Returns true
+     * on the tick the camera became usable again after a recovery.
+     */
+    bool tick()
+    {
+        unsigned long now = millis();
+        switch (_state)
+        {
+        case HEALTH_OK:
+            if (now - _at < _checkIntervalMs)
+                break;
+            _at = now;
+            if (!probe())
+                fail();
+            break;
+        case HEALTH_CPLD_RESET:
+            if (now - _at < RESET_MS)
+                break;
+            _cam.write_reg(0x07, 0x00);
+            _at = now;
+            _state = HEALTH_CPLD_SETTLE;
+            break;
+        case HEALTH_CPLD_SETTLE:
+            if (now - _at < RESET_MS)
+                break;
+            if (!probe())
+            {
+                backoff();
+                break;
+            }
+            _init.begin(JPEG);
+            _state = HEALTH_INIT;
+            break;
+        case HEALTH_INIT:
+            if (!_init.step())
+                break;
+            _state = HEALTH_OK;
+            _at = now;
+            _retryMs = RETRY_MIN_MS;
+            _captureFailures = 0;
+            _recoveries++;
+            return true;
+        case HEALTH_BACKOFF:
+            if (now - _at < _retryMs)
+                break;
+            _retryMs = (_retryMs * 2 > RETRY_MAX_MS) ? RETRY_MAX_MS : _retryMs * 2;
+            reset();
+            break;
+        }
+        return false;
+    }
+
+    /** Successful recoveries since boot. */
+    uint32_t recoveries() const { return _recoveries; }
+    /** Times the camera was found missing or unresponsive. */
+    uint32_t outages() const { return _outages; }
+
+private:
+    enum State
+    {
+        HEALTH_OK,           ///< Usable; probed every check interval
+        HEALTH_CPLD_RESET,   ///< ArduChip reset asserted
+        HEALTH_CPLD_SETTLE,  ///< ArduChip reset released, waiting before the probe
+        HEALTH_INIT,         ///< Sensor soft reset, then the JPEG init tables (SensorInit)
+        HEALTH_BACKOFF       ///< Probe failed; waiting to retry
+    };
+
+    /** SPI register read-back and OV2640 chip ID. Takes well under a millisecond of bus time. */
+    bool probe()
+    {
+        _cam.write_reg(ARDUCHIP_TEST1, 0x55);
+        if (_cam.read_reg(ARDUCHIP_TEST1) != 0x55)
+            return false;
+        uint8_t vid = 0;
+        uint8_t pid = 0;
+        _cam.wrSensorReg8_8(0xff, 0x01);
+        _cam.rdSensorReg8_8(OV2640_CHIPID_HIGH, &vid);
+        _cam.rdSensorReg8_8(OV2640_CHIPID_LOW, &pid);
+        return vid == 0x26 && (pid == 0x41 || pid == 0x42);
+    }
+
+    void fail()
+    {
+        _outages++;
+        _retryMs = RETRY_MIN_MS;
+        reset();
+    }
+
+    void reset()
+    {
+        _cam.write_reg(0x07, 0x80);
+        _at = millis();
+        _state = HEALTH_CPLD_RESET;
+    }
+
+    void backoff()
+    {
+        _at = millis();
+        _state = HEALTH_BACKOFF;
+    }
+
+    ArduCAM &_cam;
+    unsigned long _checkIntervalMs;
+    State _state;
+    unsigned long _at;
+    unsigned long _retryMs;
+    uint8_t _captureFailures;
+    SensorInit _init;
+    uint32_t _recoveries;
+    uint32_t _outages;
+};
@@ -0,0 +1,410 @@
+/**
+ * @file camera_pipeline.h
+ * @brief One capture + FIFO read-out path shared by every camera sketch.
+ *
+ * CameraPipeline owns the capture sequence (trigger, completion poll with
+ * timeout, length checks, JPEG framing) and a single FIFO reader. The
+ * reader moves CAM_BURST_CHUNK bytes per SPI buffer transfer into one
+ * buffer and hands that buffer to a FrameSink: the HTTP client, Serial,
+ * an MQTT publish, the JPEG framer or a CRC all consume the same bytes in
+ * place, with no intermediate copies.
+ *
+ * The buffer has PIPELINE_HEADROOM bytes free before each block and
+ * PIPELINE_TAILROOM after it, so a sink can add framing (such as an HTTP
+ * chunk header) around the data and still send it with one write.
+ *
+ * Every step can be driven incrementally (`ready()`, `frameStep()`,
+ * `read()` with a byte budget) from a non-blocking state machine, or in one
+ * go with `capture()` and `send()` from a simple sketch.
+ *
+ * Usage (blocking):
+ *   CameraPipeline camera(myCAM);
+ *   if (camera.capture() == CAPTURE_OK) camera.send(sink);
+ *   camera.release();
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduCAM.h>
+#include "cam_fifo.h"
+#include "crc32.h"
+#include "jpeg_framer.h"
+
+/** Free bytes before / after each block handed to a sink. */
+#define PIPELINE_HEADROOM 8
+#define PIPELINE_TAILROOM 2
+
+/** Print a 64-bit count in decimal; Print has no 64-bit overload on every core. */
+inline void printUint64(Print &out, uint64_t v)
+{
+    char buf[21];
+    char *p = buf + sizeof(buf) - 1;
+    *p = '\0';
+    do
+    {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    out.print(p);
+}
+
+/** Outcome of a capture. */
+enum CaptureResult
+{
+    CAPTURE_OK,
+    CAPTURE_EMPTY,     ///< Timed out or returned a zero-length frame
+    CAPTURE_TOO_LARGE, ///< Frame length reached the FIFO size (overflow)
+    CAPTURE_INVALID    ///< No SOI near the start or no EOI before the end (dropped)
+};
+
+/**
+ * @brief Consumer of FIFO data.
+ *
+ * `write()` receives a pipeline-owned buffer that is valid only during the
+ * call. The sink may modify it in place and may use PIPELINE_HEADROOM bytes
+ * before it and PIPELINE_TAILROOM bytes after it.
+ */
+class FrameSink
+{
+public:
+    virtual ~FrameSink() {}
+    /** Called by `CameraPipeline::send()` before the first block of `length` bytes. */
+    virtual void begin(uint32_t length) {}
+    /**
+     * Consume `n` bytes. Return false to stop the read (error, or nothing more
+     * needed); the block then does not count as delivered.
+     */
+    virtual bool write(uint8_t *buf, size_t n) = 0;
+    /** Called by `send()` after the last block; `complete` is false if the read stopped early. */
+    virtual void end(bool complete) {}
+};
+
+/**
+ * @brief Writes blocks to any Print (WiFiClient, PubSubClient, ...).
+ *
+ * With `chunked` set, each block is framed for HTTP `Transfer-Encoding:
+ * chunked` in the buffer's head/tail room and the terminating chunk is
+ * written by `end()`.
+ */
+class PrintSink : public FrameSink
+{
+public:
+    explicit PrintSink(Print &out, bool chunked = false) : _out(out), _chunked(chunked) {}
+
+    bool write(uint8_t *buf, size_t n) override
+    {
+        uint8_t *out = buf;
+        size_t outLen = n;
+        if (_chunked)
+        {
+            // [hex size CRLF][payload][CRLF]
+            char size[PIPELINE_HEADROOM];
+            int h = snprintf(size, sizeof(size), "%X\r\n", (unsigned)n);
+            out = buf - h;
+            memcpy(out, size, h);
+            buf[n] = '\r';
+            buf[n + 1] = '\n';
+            outLen = h + n + 2;
+        }
+        return _out.write(out, outLen) == outLen;
+    }
+
+    void end(bool complete) override
+    {
+        if (complete && _chunked)
+            _out.print("0\r\n\r\n");
+    }
+
+private:
+    Print &_out;
+    bool _chunked;
+};
+
+/** Computes the CRC-32 (crc32.h) of the data. */
+class Crc32Sink : public FrameSink
+{
+public:
+    Crc32Sink() : _crc(0) {}
+    void begin(uint32_t length) override { _crc = 0; }
+    bool write(uint8_t *buf, size_t n) override
+    {
+        _crc = crc32Update(_crc, buf, n);
+        return true;
+    }
+    uint32_t crc() const { return _crc; }
+
+private:
+    uint32_t _crc;
+};
+
+/** Feeds a JpegFramer; stops the read once the framer has seen enough. */
+class JpegFramerSink : public FrameSink
+{
+public:
+    explicit JpegFramerSink(JpegFramer &framer) : _framer(framer) {}
+    bool write(uint8_t *buf, size_t n) override
+    {
+        _framer.feed(buf, n);
+        return !_framer.done();
+    }
+
+private:
+    JpegFramer &_framer;
+};
+
+/**
+ * @brief Sends each block to two sinks, e.g. Serial and an analyser.
+ *
+ * The first sink must not modify the buffer in place, or the second sees
+ * the modified data.
+ */
+class FrameTee : public FrameSink
+{
+public:
+    FrameTee(FrameSink &a, FrameSink &b) : _a(a), _b(b) {}
+    void begin(uint32_t length) override
+    {
+        _a.begin(length);
+        _b.begin(length);
+    }
+    bool write(uint8_t *buf, size_t n) override { return _a.write(buf, n) && _b.write(buf, n); }
+    void end(bool complete) override
+    {
+        _a.end(complete);
+        _b.end(complete);
+    }
+
+private:
+    FrameSink &_a;
+    FrameSink &_b;
+};
+
+class CameraPipeline
+{
+public:
+    /** ArduCAM FIFO size; a frame this long has overflowed. */
+    static const uint32_t MAX_FIFO = 0x7FFFF;
+
+    /**
+     * @brief FIFO read-out counters, cumulative since boot.
+     *
+     * 64-bit, since a 32-bit microsecond total wraps after 71 minutes of
+     * read-out and a byte total after 4 GB.
+     */
+    struct Stats
+    {
+        uint64_t bytes;       ///< Bytes read from the FIFO
+        uint64_t spiMicros;   ///< Time in SPI transfers
+        uint64_t totalMicros; ///< Time in SPI transfers plus sinks
+
+        /** `{"bytes":..,"spiMs":..,"totalMs":..}` */
+        void printJson(Print &out) const
+        {
+            out.print("{\"bytes\":");
+            printUint64(out, bytes);
+            out.print(",\"spiMs\":");
+            printUint64(out, spiMicros / 1000);
+            out.print(",\"totalMs\":");
+            printUint64(out, totalMicros / 1000);
+            out.print("}");
+        }
+    };
+
+    explicit CameraPipeline(ArduCAM &cam, unsigned long captureTimeoutMs = 2000)
+        : _cam(cam), _timeoutMs(captureTimeoutMs), _startedAt(0), _doneAt(0), _fifoLength(0),
+          _framingRemaining(0), _result(CAPTURE_EMPTY), _timedOut(false), _stats{0, 0, 0}, _framerSink(_framer)
+    {
+    }
+
+    /** --- Capture ------------------------------------------------------- */
+
+    /** Start a capture into the FIFO (overwriting whatever it held). Does not wait. */
+    void trigger()
+    {
+        _cam.flush_fifo();
+        _cam.clear_fifo_flag();
+        _cam.start_capture();
+        _startedAt = millis();
+        _fifoLength = 0;
+    }
+
+    /** True once the capture has finished or timed out. */
+    bool ready()
+    {
+        return _cam.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK) || millis() - _startedAt > _timeoutMs;
+    }
+
+    /**
+     * @brief Check the finished capture's FIFO length. Call once `ready()`.
+     *
+     * Returns CAPTURE_OK when the FIFO holds data worth framing.
+     */
+    CaptureResult finish()
+    {
+        // A timed-out capture leaves CAP_DONE_MASK clear; treat it as empty.
+        bool done = _cam.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK);
+        _timedOut = !done;
+        _fifoLength = done ? _cam.read_fifo_length() : 0;
+        _doneAt = millis();
+        if (_fifoLength == 0)
+            _result = CAPTURE_EMPTY;
+        else if (_fifoLength >= MAX_FIFO)
+            _result = CAPTURE_TOO_LARGE;
+        else
+            _result = CAPTURE_OK;
+        return _result;
+    }
+
+    /**
+     * @brief Start scanning the FIFO for the JPEG; advance with `frameStep()`.
+     *
+     * The FIFO stays in burst mode until framing completes, so nothing else
+     * may use the SPI bus in between.
+     */
+    void beginFraming()
+    {
+        _framer.begin();
+        _framingRemaining = _fifoLength;
+        open(0);
+    }
+
+    /**
+     * @brief Scan up to `budget` more bytes. Returns true when framing is finished;
+     * `result()` then says whether a complete JPEG was found.
+     */
+    bool frameStep(uint32_t budget)
+    {
+        uint32_t n = (budget < _framingRemaining) ? budget : _framingRemaining;
+        _framingRemaining -= read(_framerSink, n);
+        if (_framingRemaining && !_framer.done())
+            return false;
+        close();
+        _result = _framer.end() ? CAPTURE_OK : CAPTURE_INVALID;
+        return true;
+    }
+
+    /** Frame the whole FIFO at SPI speed. */
+    CaptureResult frame()
+    {
+        beginFraming();
+        while (!frameStep(_fifoLength))
+        {
+        }
+        return _result;
+    }
+
+    /** Trigger, wait for completion, check and frame. Blocks for the capture time. */
+    CaptureResult capture()
+    {
+        trigger();
+        while (!ready())
+        {
+        }
+        if (finish() != CAPTURE_OK)
+            return _result;
+        return frame();
+    }
+
+    /** Clear the capture-done flag once the frame has been used. */
+    void release() { _cam.clear_fifo_flag(); }
+
+    /** --- Read-out ------------------------------------------------------ */
+
+    /** Rewind the FIFO, enter burst mode and skip `offset` bytes. */
+    void open(uint32_t offset)
+    {
+        camRewind(_cam);
+        camBurstBegin(_cam);
+        camBurstSkip(offset);
+    }
+
+    /**
+     * @brief Read up to `n` FIFO bytes into `sink`, one block at a time.
+     *
+     * Returns the number of bytes the sink accepted; fewer than `n` if the
+     * sink stopped the read, since the block it refused is not counted (so a
+     * failed write of the last block still reads as a short transfer). The
+     * FIFO must be open.
+     */
+    uint32_t read(FrameSink &sink, uint32_t n)
+    {
+        uint32_t done = 0;
+        uint32_t fetched = 0;
+        unsigned long t0 = micros();
+        while (done < n)
+        {
+            size_t k = (n - done > CAM_BURST_CHUNK) ? CAM_BURST_CHUNK : n - done;
+            unsigned long t = micros();
+            camBurstRead(_buf + PIPELINE_HEADROOM, k);
+            _stats.spiMicros += micros() - t;
+            fetched += k;
+            if (!sink.write(_buf + PIPELINE_HEADROOM, k))
+                break;
+            done += k;
+        }
+        _stats.bytes += fetched;
+        _stats.totalMicros += micros() - t0;
+        return done;
+    }
+
+    /** Leave burst mode and release the SPI bus. */
+    void close() { camBurstEnd(_cam); }
+
+    /**
+     * @brief Send `length` bytes from FIFO offset `offset` to `sink`, with begin()/end().
+     *
+     * Returns true when everything was delivered.
+     */
+    bool sendRange(FrameSink &sink, uint32_t offset, uint32_t length)
+    {
+        open(offset);
+        sink.begin(length);
+        bool complete = read(sink, length) == length;
+        close();
+        sink.end(complete);
+        return complete;
+    }
+
+    /** Send the framed JPEG to `sink`. */
+    bool send(FrameSink &sink) { return sendRange(sink, start(), length()); }
+
+    /** CRC-32 of the framed JPEG (an extra pass over the FIFO at SPI speed). */
+    uint32_t crc()
+    {
+        Crc32Sink sink;
+        send(sink);
+        return sink.crc();
+    }
+
+    /** --- State -------------------------------------------------------- */
+
+    CaptureResult result() const { return _result; }
+    /** The last capture hit the timeout instead of setting CAP_DONE_MASK. */
+    bool timedOut() const { return _timedOut; }
+    JpegFramer &framer() { return _framer; }
+    /** Offset of the JPEG in the FIFO. */
+    uint32_t start() const { return _framer.start(); }
+    /** Exact JPEG length (0 unless framing succeeded). */
+    uint32_t length() const { return _framer.length(); }
+    /** FIFO length reported by the last `finish()`. */
+    uint32_t fifoLength() const { return _fifoLength; }
+    /** millis() when the last capture was triggered / finished. */
+    unsigned long startedAt() const { return _startedAt; }
+    unsigned long doneAt() const { return _doneAt; }
+    const Stats &stats() const { return _stats; }
+    void resetStats() { _stats = Stats{0, 0, 0}; }
+
+private:
+    ArduCAM &_cam;
+    unsigned long _timeoutMs;
+    unsigned long _startedAt;
+    unsigned long _doneAt;
+    uint32_t _fifoLength;
+    uint32_t _framingRemaining;
+    CaptureResult _result;
+    bool _timedOut;
+    Stats _stats;
+    JpegFramer _framer;
+    JpegFramerSink _framerSink;
+    uint8_t _buf[PIPELINE_HEADROOM + CAM_BURST_CHUNK + PIPELINE_TAILROOM];
+};
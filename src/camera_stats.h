@@ -0,0 +1,175 @@
+/**
+ * @file camera_stats.h
+ * @brief Fixed-bucket histograms and counters for the camera pipeline.
+ *
+ * Each histogram has a compile-time list of bucket upper bounds plus an
+ * overflow bucket, and keeps the sample count, sum and maximum alongside
+ * the bucket counts. Recording a sample is a short linear scan; nothing is
+ * allocated, so the whole set costs a few hundred bytes of RAM.
+ *
+ * CameraStats groups what is needed to tune resolution and read-out chunk
+ * size: how long captures take to set CAP_DONE_MASK, how large the FIFO
+ * contents are, how long a frame takes to stream and at what rate, plus
+ * counters for timed-out captures and 204 / 413 responses.
+ *
+ * Bucket counts are cumulative since boot (or the last `reset()`), so a
+ * poller can take differences between two reads.
+ *
+ * Usage:
+ *   stats.captureMs.record(camera.doneAt() - camera.startedAt());
+ *   stats.printJson(client);
+ */
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Histogram over `N` bucket upper bounds (inclusive) and one overflow bucket.
+ */
+template <uint8_t N>
+class Histogram
+{
+public:
+    /** @param bounds Ascending bucket upper bounds; must outlive the histogram. */
+    explicit Histogram(const uint32_t (&bounds)[N]) : _bounds(bounds) { reset(); }
+
+    void reset()
+    {
+        memset(_counts, 0, sizeof(_counts));
+        _count = 0;
+        _sum = 0;
+        _max = 0;
+    }
+
+    void record(uint32_t value)
+    {
+        uint8_t i = 0;
+        while (i < N && value > _bounds[i])
+            i++;
+        _counts[i]++;
+        _count++;
+        _sum += value;
+        if (value > _max)
+            _max = value;
+    }
+
+    uint32_t count() const { return _count; }
+    /** Mean of the recorded samples (0 when empty). */
+    uint32_t mean() const { return _count ? (uint32_t)(_sum / _count) : 0; }
+    uint32_t max() const { return _max; }
+
+    /**
+     * @brief Print as `{"le":[...],"counts":[...],"count":n,"mean":m,"max":x}`.
+     *
+     * `counts` has one more entry than `le`: the last is the overflow bucket.
+     */
+    void printJson(Print &out) const
+    {
+        out.print(F("{\"le\":["));
+        for (uint8_t i = 0; i < N; ++i)
+        {
+            if (i)
+                out.print(',');
+            out.print(_bounds[i]);
+        }
+        out.print(F("],\"counts\":["));
+        for (uint8_t i = 0; i <= N; ++i)
+        {
+            if (i)
+                out.print(',');
+            out.print(_counts[i]);
+        }
+        out.print(F("],\"count\":"));
+        out.print(_count);
+        out.print(F(",\"mean\":"));
+        out.print(mean());
+        out.print(F(",\"max\":"));
+        out.print(_max);
+        out.print('}');
+    }
+
+private:
+    const uint32_t *_bounds;
+    uint32_t _counts[N + 1];
+    uint32_t _count;
+    uint64_t _sum;
+    uint32_t _max;
+};
+
+/** Capture time (ms) from trigger to CAP_DONE_MASK; the last bucket is the 2 s timeout. */
+static const uint32_t CAPTURE_MS_BOUNDS[] = {50, 100, 200, 300, 500, 800, 1200, 2000};
+/** FIFO length (bytes) of completed captures, up to the 512 KB FIFO. */
+static const uint32_t FIFO_BYTES_BOUNDS[] = {4096, 8192, 16384, 32768, 65536, 131072, 262144, 524288};
+/** Time (ms) to stream one frame to a client. */
+static const uint32_t STREAM_MS_BOUNDS[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000};
+/** Streaming throughput (bytes/s). */
+static const uint32_t STREAM_BPS_BOUNDS[] = {8192, 16384, 32768, 65536, 131072, 262144, 524288, 1048576};
+
+struct CameraStats
+{
+    Histogram<8> captureMs{CAPTURE_MS_BOUNDS};
+    Histogram<8> fifoBytes{FIFO_BYTES_BOUNDS};
+    Histogram<8> streamMs{STREAM_MS_BOUNDS};
+    Histogram<8> streamBps{STREAM_BPS_BOUNDS};
+    uint32_t timeouts = 0;      ///< Captures that hit the capture timeout
+    uint32_t noContent = 0;     ///< `/image` answered 204 (no valid frame)
+    uint32_t tooLarge = 0;      ///< `/image` answered 413 (FIFO overflow)
+    uint32_t unavailable = 0;   ///< `/image` answered 503 (camera disabled or busy)
+    uint32_t streamAborted = 0; ///< Streams the client stopped accepting part-way
+
+    /** Record one finished capture: its duration, and its FIFO length unless it timed out. */
+    void recordCapture(unsigned long ms, uint32_t fifoLength, bool timedOut)
+    {
+        captureMs.record(ms);
+        if (timedOut)
+            timeouts++;
+        else if (fifoLength)
+            fifoBytes.record(fifoLength);
+    }
+
+    /** Record one frame streamed to a client. Short frames are left out of the throughput. */
+    void recordStream(uint32_t bytes, unsigned long ms, bool complete)
+    {
+        if (!complete)
+        {
+            streamAborted++;
+            return;
+        }
+        streamMs.record(ms);
+        if (bytes >= 1024 && ms)
+            streamBps.record((uint32_t)((uint64_t)bytes * 1000 / ms));
+    }
+
+    void reset()
+    {
+        captureMs.reset();
+        fifoBytes.reset();
+        streamMs.reset();
+        streamBps.reset();
+        timeouts = noContent = tooLarge = unavailable = streamAborted = 0;
+    }
+
+    /** Print the histograms and counters as one JSON object. */
+    void printJson(Print &out) const
+    {
+        out.print(F("{\"captureMs\":"));
+        captureMs.printJson(out);
+        out.print(F(",\"fifoBytes\":"));
+        fifoBytes.printJson(out);
+        out.print(F(",\"streamMs\":"));
+        streamMs.printJson(out);
+        out.print(F(",\"streamBytesPerSec\":"));
+        streamBps.printJson(out);
+        out.print(F(",\"timeouts\":"));
+        out.print(timeouts);
+        out.print(F(",\"noContent\":"));
+        out.print(noContent);
+        out.print(F(",\"tooLarge\":"));
+        out.print(tooLarge);
+        out.print(F(",\"unavailable\":"));
+        out.print(unavailable);
+        out.print(F(",\"streamAborted\":"));
+        out.print(streamAborted);
+        out.print('}');
+    }
+};
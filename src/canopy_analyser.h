@@ -0,0 +1,282 @@
+/**
+ * @file canopy_analyser.h
+ * @brief Excess-green canopy cover measured from an RGB565 frame.
+ *
+ * Instead of shipping a picture, the camera is briefly switched to RGB565
+ * (BMP) mode and the frame is scanned as it is read from the FIFO: each
+ * pixel's excess-green index in chromatic coordinates,
+ *
+ *   ExG = 2g - r - b,  with r, g, b = R, G, B / (R + G + B),
+ *
+ * is added to a histogram, and pixels above CANOPY_EXG_THRESHOLD count as
+ * canopy. Nothing is buffered: the analyser is a FrameSink that sees each
+ * block once. Very dark pixels have no meaningful chromaticity and are only
+ * counted.
+ *
+ * The result is a handful of numbers (cover percentage, mean ExG and a
+ * coarse histogram) sent with the regular sensor telemetry, in place of a
+ * 10-150 KB image.
+ *
+ * CanopyProbe runs the whole measurement as a small state machine driven
+ * by `tick()`: switch to BMP, wait for the sensor to settle, capture, scan
+ * the FIFO a slice per tick, switch back to JPEG and settle again.
+ *
+ * Usage:
+ *   probe.start(OV2640_320x240);                // FIFO contents are lost
+ *   while (probe.busy())
+ *       if (probe.tick(2048)) use(probe.result());
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduCAM.h>
+#include "camera_health.h"
+#include "camera_pipeline.h"
+
+/** ExG (hundredths) above which a pixel counts as canopy. */
+#ifndef CANOPY_EXG_THRESHOLD
+#define CANOPY_EXG_THRESHOLD 10
+#endif
+/** Pixels with R + G + B (8-bit channels) below this are counted as dark and skipped. */
+#ifndef CANOPY_DARK_SUM
+#define CANOPY_DARK_SUM 48
+#endif
+
+/** Histogram of ExG from -1.00 to 2.00 (its full range) in 0.25 steps. */
+#define CANOPY_HIST_BINS 12
+#define CANOPY_HIST_MIN -100
+#define CANOPY_HIST_WIDTH 25
+
+struct CanopyStats
+{
+    bool valid;                      ///< A frame has been analysed
+    unsigned long at;                ///< millis() when the analysis finished
+    uint32_t pixels;                 ///< Pixels analysed (not dark)
+    uint32_t dark;                   ///< Pixels skipped as too dark
+    uint32_t canopy;                 ///< Pixels with ExG above the threshold
+    int32_t exgSum;                  ///< Sum of ExG over analysed pixels (hundredths)
+    uint32_t hist[CANOPY_HIST_BINS]; ///< Analysed pixels per ExG bin
+
+    /** Canopy share of the analysed pixels, in permille. */
+    uint16_t coverPermille() const { return pixels ? (uint16_t)((uint64_t)canopy * 1000 / pixels) : 0; }
+    /** Mean ExG in hundredths. */
+    int16_t meanExg() const { return pixels ? (int16_t)(exgSum / (int32_t)pixels) : 0; }
+};
+
+/** FrameSink that accumulates CanopyStats over RGB565 pixels (high byte first). */
+class CanopyAnalyser : public FrameSink
+{
+public:
+    CanopyAnalyser() { begin(0); }
+
+    void begin(uint32_t length) override
+    {
+        memset(&_stats, 0, sizeof(_stats));
+    }
+
+    bool write(uint8_t *buf, size_t n) override
+    {
+        // Blocks are CAM_BURST_CHUNK bytes (even), so a pixel never straddles two.
+        for (size_t i = 0; i + 1 < n; i += 2)
+        {
+            uint8_t hi = buf[i];
+            uint8_t lo = buf[i + 1];
+            int16_t r = hi & 0xF8;
+            int16_t g = ((hi & 0x07) << 5) | ((lo & 0xE0) >> 3);
+            int16_t b = (lo & 0x1F) << 3;
+            int16_t sum = r + g + b;
+            if (sum < CANOPY_DARK_SUM)
+            {
+                _stats.dark++;
+                continue;
+            }
+            int16_t exg = (int16_t)((int32_t)(2 * g - r - b) * 100 / sum);
+            _stats.pixels++;
+            _stats.exgSum += exg;
+            if (exg > CANOPY_EXG_THRESHOLD)
+                _stats.canopy++;
+            int16_t bin = (exg - CANOPY_HIST_MIN) / CANOPY_HIST_WIDTH;
+            if (bin < 0)
+                bin = 0;
+            if (bin >= CANOPY_HIST_BINS)
+                bin = CANOPY_HIST_BINS - 1;
+            _stats.hist[bin]++;
+        }
+        return true;
+    }
+
+    void end(bool complete) override
+    {
+        _stats.valid = complete;
+        _stats.at = millis();
+    }
+
+    const CanopyStats &stats() const { return _stats; }
+
+private:
+    CanopyStats _stats;
+};
+
+/**
+ * @brief Format `s` as a JSON object, or `null` when no frame has been analysed.
+ *
+ * Fields: cover (percent), exg (mean), age (seconds), hist (permille per
+ * bin, ExG -1.00 to 2.00 in 0.25 steps). Returns the length written.
+ */
+inline size_t canopyFormatJson(char *out, size_t size, const CanopyStats &s, unsigned long now)
+{
+    if (!s.valid)
+        return snprintf(out, size, "null");
+    uint16_t cover = s.coverPermille();
+    int16_t exg = s.meanExg();
+    int n = snprintf(out, size, "{\"cover\":%u.%u,\"exg\":%s%u.%02u,\"age\":%lu,\"hist\":[", (unsigned)(cover / 10),
+                     (unsigned)(cover % 10), exg < 0 ? "-" : "", (unsigned)(abs(exg) / 100), (unsigned)(abs(exg) % 100),
+                     (now - s.at) / 1000);
+    for (uint8_t i = 0; i < CANOPY_HIST_BINS && n > 0 && (size_t)n < size; ++i)
+    {
+        uint32_t permille = s.pixels ? (uint32_t)((uint64_t)s.hist[i] * 1000 / s.pixels) : 0;
+        n += snprintf(out + n, size - n, i ? ",%lu" : "%lu", (unsigned long)permille);
+    }
+    if (n > 0 && (size_t)n < size)
+        n += snprintf(out + n, size - n, "]}");
+    return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+/**
+ * @brief Runs one canopy measurement on the camera, a step per `tick()`.
+ *
+ * While busy the probe owns the camera and its FIFO; the sketch must not
+ * capture or read frames until `busy()` is false. Both format switches go
+ * through SensorInit, a few sensor registers per tick.
+ */
+class CanopyProbe
+{
+public:
+    /** Sensor settle time after a format change (ms), as for a resize. */
+    static const unsigned long SETTLE_MS = 1000;
+
+    /**
+     * @param cam    Camera to switch between JPEG and BMP
+     * @param camera Pipeline used to capture and read the FIFO
+     * @param width, height  RGB565 frame size in BMP mode
+     */
+    CanopyProbe(ArduCAM &cam, CameraPipeline &camera, uint16_t width = 320, uint16_t height = 240)
+        : _cam(cam), _camera(camera), _init(cam), _bytes((uint32_t)width * height * 2), _state(IDLE), _at(0),
+          _remaining(0), _jpegSize(0), _failures(0)
+    {
+        memset(&_result, 0, sizeof(_result));
+    }
+
+    /** Switch the sensor to RGB565 and start a measurement. `jpegSize` is restored afterwards. */
+    void start(uint8_t jpegSize)
+    {
+        _jpegSize = jpegSize;
+        _init.begin(BMP);
+        _state = INIT_BMP;
+    }
+
+    bool busy() const { return _state != IDLE; }
+
+    /**
+     * @brief Advance by one step, scanning at most `budget` FIFO bytes.
+     *
+     * Returns true on the tick that produced a new `result()`.
+     */
+    bool tick(uint32_t budget)
+    {
+        switch (_state)
+        {
+        case IDLE:
+            break;
+        case INIT_BMP:
+            if (_init.step())
+            {
+                _at = millis();
+                _state = SETTLE_BMP;
+            }
+            break;
+        case SETTLE_BMP:
+            if (millis() - _at >= SETTLE_MS)
+            {
+                _camera.trigger();
+                _state = TRIGGERED;
+            }
+            break;
+        case TRIGGERED:
+            if (!_camera.ready())
+                break;
+            if (_camera.finish() != CAPTURE_OK || _camera.fifoLength() < _bytes)
+            {
+                _failures++;
+                restore();
+                break;
+            }
+            _analyser.begin(_bytes);
+            _remaining = _bytes;
+            _camera.open(0);
+            _state = ANALYSING;
+            break;
+        case ANALYSING:
+        {
+            uint32_t n = (budget < _remaining) ? budget : _remaining;
+            _remaining -= _camera.read(_analyser, n);
+            if (_remaining)
+                break;
+            _camera.close();
+            _analyser.end(true);
+            _result = _analyser.stats();
+            restore();
+            return true;
+        }
+        case INIT_JPEG:
+            if (_init.step())
+            {
+                _at = millis();
+                _state = SETTLE_JPEG;
+            }
+            break;
+        case SETTLE_JPEG:
+            if (millis() - _at >= SETTLE_MS)
+                _state = IDLE;
+            break;
+        }
+        return false;
+    }
+
+    /** Last successful measurement (`valid` is false until the first). */
+    const CanopyStats &result() const { return _result; }
+    /** Measurements abandoned because the capture was empty or short. */
+    uint32_t failures() const { return _failures; }
+
+private:
+    enum State
+    {
+        IDLE,
+        INIT_BMP,    ///< Sensor being switched to RGB565 (SensorInit)
+        SETTLE_BMP,  ///< Sensor switched to RGB565, waiting for exposure to settle
+        TRIGGERED,   ///< RGB565 frame being captured
+        ANALYSING,   ///< FIFO being scanned, a slice per tick
+        INIT_JPEG,   ///< Sensor being switched back to JPEG at `_jpegSize` (SensorInit)
+        SETTLE_JPEG  ///< Sensor switched back to JPEG, waiting for it to settle
+    };
+
+    void restore()
+    {
+        _camera.release();
+        _init.begin(JPEG);
+        _init.add(SensorInit::jpegSizeTable(_jpegSize));
+        _state = INIT_JPEG;
+    }
+
+    ArduCAM &_cam;
+    CameraPipeline &_camera;
+    SensorInit _init;
+    uint32_t _bytes;
+    State _state;
+    unsigned long _at;
+    uint32_t _remaining;
+    uint8_t _jpegSize;
+    uint32_t _failures;
+    CanopyAnalyser _analyser;
+    CanopyStats _result;
+};
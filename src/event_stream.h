@@ -0,0 +1,188 @@
+/**
+ * @file event_stream.h
+ * @brief Server-Sent Events (`text/event-stream`) push to a few clients.
+ *
+ * An EventSource connection is a response that never ends: after the head,
+ * the server writes events whenever it has something new,
+ *
+ *   event: sensor
+ *   data: {"temperature":23.4,...}
+ *   <blank line>
+ *
+ * and the browser reconnects by itself if the connection drops. EventStream
+ * keeps up to EVENTS_MAX_CLIENTS such connections. It is a Print: an event
+ * is started with `begin()`, its data printed with the usual Print calls
+ * (so the JSON printers that fill HTTP responses are reused) and `end()`
+ * writes it to every client with one write each. Data must be a single line,
+ * which JSON without pretty-printing is.
+ *
+ * When nothing has been sent for EVENTS_HEARTBEAT_MS, `tick()` sends a
+ * comment line so proxies and the WiFi bridge keep the idle connection open
+ * and dead clients are found. Clients whose write fails are dropped.
+ *
+ * Usage:
+ *   events.add(client);                 // after sending the response head
+ *   events.begin("sensor");
+ *   events.print("{");
+ *   printReadingsFields(events);
+ *   events.print("}");
+ *   events.end();
+ *   // in loop():
+ *   events.tick();
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiS3.h>
+
+#ifndef EVENTS_MAX_CLIENTS
+#define EVENTS_MAX_CLIENTS 2
+#endif
+/** Largest event (name, data and framing) in bytes; longer events are dropped. */
+#ifndef EVENTS_MAX_EVENT
+#define EVENTS_MAX_EVENT 256
+#endif
+/** Comment sent on an otherwise idle connection this often (ms). */
+#ifndef EVENTS_HEARTBEAT_MS
+#define EVENTS_HEARTBEAT_MS 15000
+#endif
+/** Reconnect delay suggested to the browser (ms). */
+#ifndef EVENTS_RETRY_MS
+#define EVENTS_RETRY_MS 5000
+#endif
+
+class EventStream : public Print
+{
+public:
+    EventStream() : _count(0), _len(0), _overflow(false), _lastSentAt(0), _sent(0)
+    {
+        for (uint8_t i = 0; i < EVENTS_MAX_CLIENTS; ++i)
+            _clients[i].active = false;
+    }
+
+    /**
+     * @brief Take over a client whose `text/event-stream` head has been sent.
+     *
+     * Returns false when the table is full; the caller then answers 503.
+     */
+    bool add(WiFiClient &client)
+    {
+        for (uint8_t i = 0; i < EVENTS_MAX_CLIENTS; ++i)
+        {
+            if (_clients[i].active)
+                continue;
+            char retry[24];
+            int n = snprintf(retry, sizeof(retry), "retry: %u\n\n", (unsigned)EVENTS_RETRY_MS);
+            if (client.write((const uint8_t *)retry, n) != (size_t)n)
+                return false;
+            _clients[i].client = client;
+            _clients[i].active = true;
+            _count++;
+            return true;
+        }
+        return false;
+    }
+
+    /** Clients connected. */
+    uint8_t count() const { return _count; }
+
+    /** Start an event named `event`; print its data next, then call `end()`. */
+    void begin(const char *event)
+    {
+        _len = 0;
+        _overflow = false;
+        print("event: ");
+        print(event);
+        print("\ndata: ");
+    }
+
+    /** Finish the event and send it to every client. Returns false if it was too long. */
+    bool end()
+    {
+        print("\n\n");
+        if (_overflow)
+            return false;
+        send(_buf, _len);
+        _sent++;
+        return true;
+    }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *data, size_t n) override
+    {
+        if (_len + n > EVENTS_MAX_EVENT)
+        {
+            _overflow = true;
+            return 0;
+        }
+        memcpy(_buf + _len, data, n);
+        _len += n;
+        return n;
+    }
+
+    using Print::write;
+
+    /** Send a heartbeat comment when the connections have been quiet for EVENTS_HEARTBEAT_MS. */
+    void tick()
+    {
+        if (_count == 0 || millis() - _lastSentAt < EVENTS_HEARTBEAT_MS)
+            return;
+        static const uint8_t PING[] = {':', ' ', 'p', 'i', 'n', 'g', '\n', '\n'};
+        send(PING, sizeof(PING));
+    }
+
+    /** Events sent since boot. */
+    uint32_t sent() const { return _sent; }
+
+    /**
+     * @brief Discard data a client sent on its stream, if it is one of ours.
+     *
+     * Event streams are one-way; anything arriving on one is not a request.
+     * Returns false for other clients.
+     */
+    bool drain(WiFiClient &client)
+    {
+        for (uint8_t i = 0; i < EVENTS_MAX_CLIENTS; ++i)
+        {
+            if (!_clients[i].active || !(_clients[i].client == client))
+                continue;
+            while (_clients[i].client.available() > 0)
+                _clients[i].client.read();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Client
+    {
+        WiFiClient client;
+        bool active;
+    };
+
+    void send(const uint8_t *data, size_t n)
+    {
+        _lastSentAt = millis();
+        for (uint8_t i = 0; i < EVENTS_MAX_CLIENTS; ++i)
+        {
+            Client &c = _clients[i];
+            if (!c.active)
+                continue;
+            if (c.client.write(data, n) != n)
+            {
+                c.client.stop();
+                c.active = false;
+                _count--;
+            }
+        }
+    }
+
+    Client _clients[EVENTS_MAX_CLIENTS];
+    uint8_t _count;
+    uint8_t _buf[EVENTS_MAX_EVENT];
+    size_t _len;
+    bool _overflow;
+    unsigned long _lastSentAt;
+    uint32_t _sent;
+};
@@ -0,0 +1,163 @@
+/**
+ * @file http_response.h
+ * @brief Stack-buffered HTTP response sent with a single write.
+ *
+ * On the UNO R4 WiFi every `client.print()` is a command over the serial
+ * AT bridge to the ESP32-S3 and often leaves as its own TCP segment, so a
+ * JSON response printed piece by piece costs dozens of round trips.
+ * HttpResponse is a Print that collects the body in a buffer on the stack;
+ * `send()` then formats the status line and headers, including
+ * `Content-Length`, into head room reserved in front of the body and
+ * writes head and body with one `write()`.
+ *
+ * The body is printed with the usual Print calls, so existing JSON printers
+ * that take a `Print &` fill it unchanged. A body that does not fit is
+ * answered with an empty 500 instead of being sent truncated; so are headers
+ * that do not fit HTTP_HEAD_ROOM, and that 500 also closes the connection.
+ *
+ * The `Connection` header follows `httpKeepAlive()`, which the server sets
+ * for each request (http_server.h); it is false outside a request, so other
+ * ports keep closing their connections.
+ *
+ * Usage:
+ *   HttpResponse<512> res;
+ *   printStatusJson(res);
+ *   res.send(client, 200, "OK", "application/json");
+ *
+ * On the host, build with `-Itools/host`: tools/host/Arduino.h provides Print
+ * (see tools/http_response_bench.cpp).
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+/** Bytes reserved in front of the body for the status line and headers. */
+#ifndef HTTP_HEAD_ROOM
+#define HTTP_HEAD_ROOM 192
+#endif
+
+/**
+ * @brief Whether the response to the current request keeps the connection open.
+ *
+ * Set by the server before a handler runs. A handler clears it when the
+ * connection cannot be reused, e.g. after a body it could not finish.
+ */
+inline bool &httpKeepAlive()
+{
+    static bool keepAlive = false;
+    return keepAlive;
+}
+
+template <size_t BODY>
+class HttpResponse : public Print
+{
+public:
+    HttpResponse() : _len(0), _overflow(false) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *data, size_t n) override
+    {
+        if (_len + n > BODY)
+        {
+            _overflow = true;
+            return 0;
+        }
+        memcpy(_buf + HTTP_HEAD_ROOM + _len, data, n);
+        _len += n;
+        return n;
+    }
+
+    using Print::write;
+
+    /** Body bytes collected so far. */
+    size_t length() const { return _len; }
+    /** A write did not fit; `send()` will answer 500. */
+    bool overflowed() const { return _overflow; }
+
+    /**
+     * @brief Send status line, headers and body in one write.
+     *
+     * @param out     Client to write to
+     * @param status  Status code; 204 and 304 are sent without a body or `Content-Length`
+     * @param reason  Reason phrase, e.g. "OK"
+     * @param type    `Content-Type`, or nullptr for none
+     * @param headers Extra header lines, each ending in "\r\n", or nullptr
+     *
+     * Returns the number of bytes the client accepted.
+     */
+    size_t send(Print &out, uint16_t status, const char *reason, const char *type = nullptr,
+                const char *headers = nullptr)
+    {
+        if (_overflow)
+        {
+            _len = 0;
+            _overflow = false;
+            return emit(out, 500, "Internal Server Error", nullptr, nullptr, true);
+        }
+        bool body = status != 204 && status != 304;
+        if (!body)
+            _len = 0;
+        return emit(out, status, reason, type, headers, body);
+    }
+
+    /**
+     * @brief Send only the status line and headers, for a body the caller
+     * streams afterwards (e.g. with `Transfer-Encoding: chunked` in `headers`).
+     */
+    size_t sendHead(Print &out, uint16_t status, const char *reason, const char *type = nullptr,
+                    const char *headers = nullptr)
+    {
+        _len = 0;
+        return emit(out, status, reason, type, headers, false);
+    }
+
+private:
+    size_t emit(Print &out, uint16_t status, const char *reason, const char *type, const char *headers,
+                bool contentLength)
+    {
+        // Format the head at the start of the buffer, then move it up against the body.
+        char *head = (char *)_buf;
+        size_t n = 0;
+        bool fits = true;
+        n = append(head, n, fits, "HTTP/1.1 %u %s\r\n", (unsigned)status, reason);
+        if (type)
+            n = append(head, n, fits, "Content-Type: %s\r\n", type);
+        if (contentLength)
+            n = append(head, n, fits, "Content-Length: %u\r\n", (unsigned)_len);
+        if (headers)
+            n = append(head, n, fits, "%s", headers);
+        n = append(head, n, fits, "%s",
+                   httpKeepAlive() ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+        if (!fits)
+        {
+            // A cut-off head cannot be framed; the client gets a fixed 500 and the connection ends.
+            static const char HEAD_OVERFLOW[] =
+                "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            httpKeepAlive() = false;
+            return out.write((const uint8_t *)HEAD_OVERFLOW, sizeof(HEAD_OVERFLOW) - 1);
+        }
+        uint8_t *start = _buf + HTTP_HEAD_ROOM - n;
+        memmove(start, head, n);
+        return out.write(start, n + _len);
+    }
+
+    /** snprintf at `n`; clears `fits` if the text does not fit in HTTP_HEAD_ROOM. */
+    template <typename... Args>
+    static size_t append(char *head, size_t n, bool &fits, const char *fmt, Args... args)
+    {
+        int k = snprintf(head + n, HTTP_HEAD_ROOM - n, fmt, args...);
+        if (k < 0 || n + k >= HTTP_HEAD_ROOM)
+        {
+            fits = false;
+            return n;
+        }
+        return n + k;
+    }
+
+    uint8_t _buf[HTTP_HEAD_ROOM + BODY];
+    size_t _len;
+    bool _overflow;
+};
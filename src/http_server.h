@@ -0,0 +1,456 @@
+/**
+ * @file http_server.h
+ * @brief HTTP/1.1 server with persistent connections for the dashboard.
+ *
+ * UnoR4WiFi_WebServer closes every client after one request, so each
+ * dashboard poll paid a TCP handshake over the serial bridge to the
+ * ESP32-S3. HttpServer keeps up to HTTP_MAX_CONNECTIONS sockets open in a
+ * small table. `WiFiServer::available()` returns whichever socket has data
+ * waiting, new or already known, and `handleClient()` serves one request
+ * from it per call.
+ *
+ * A connection stays open after a response unless the client asked for
+ * `Connection: close` or spoke HTTP/1.0, it has served HTTP_MAX_REQUESTS
+ * requests, or the handler cancelled it with `httpKeepAlive() = false`
+ * (e.g. a body that could not be completed). Connections idle for longer
+ * than HTTP_IDLE_TIMEOUT are closed. A client beyond the table is still
+ * served, with `Connection: close`. A handler that keeps the socket for
+ * itself (an event stream, a WebSocket) calls `detach()`; the server then
+ * forgets it without closing it. Data arriving later on a detached socket
+ * is offered to the claim handler first, so it is not parsed as HTTP.
+ *
+ * The request line and headers must arrive within HTTP_HEADER_DEADLINE;
+ * otherwise the client gets 408 and the connection is closed. A body still
+ * missing at the deadline closes the connection after the response.
+ *
+ * Routes use the UnoR4WiFi_WebServer handler signature and parameters, so
+ * handlers did not change:
+ *   (WiFiClient &client, const String &method, const String &request,
+ *    const QueryParams &params, const String &jsonData)
+ * `request` holds the request line and headers. Basic Auth is checked
+ * against the credentials given to `enableAuthentication()`.
+ *
+ * Usage:
+ *   server.addRoute("/status", handleStatus);
+ *   server.enableAuthentication(user, pass, "realm");
+ *   server.begin();
+ *   // in loop():
+ *   server.handleClient();
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiS3.h>
+#include "base64.h"
+#include "http_response.h"
+
+/** Persistent connections kept open at once (the ESP32-S3 bridge has few sockets). */
+#ifndef HTTP_MAX_CONNECTIONS
+#define HTTP_MAX_CONNECTIONS 3
+#endif
+/** Close a persistent connection after this long without a request (ms); above the dashboard poll interval. */
+#ifndef HTTP_IDLE_TIMEOUT
+#define HTTP_IDLE_TIMEOUT 15000
+#endif
+/** Requests served on one connection before it is closed. */
+#ifndef HTTP_MAX_REQUESTS
+#define HTTP_MAX_REQUESTS 100
+#endif
+#define HTTP_MAX_ROUTES 10
+#define HTTP_MAX_PARAMS 8
+/** Largest request body read (bytes); longer bodies are refused. */
+#define HTTP_MAX_BODY 512
+/** Time allowed for the whole request line, headers and body to arrive (ms). */
+#ifndef HTTP_HEADER_DEADLINE
+#define HTTP_HEADER_DEADLINE 200
+#endif
+/** Longest request or header line accepted (bytes). */
+#define HTTP_MAX_LINE 256
+
+/**
+ * @brief Read one request or header line, giving up at `deadline` (millis()).
+ *
+ * Reads only bytes that have arrived, so a slow or stalled client costs at
+ * most the time left before the deadline, however many lines it sends.
+ * `line` receives the text without the line ending. Returns false when the
+ * deadline passes, the client disconnects or the line is too long.
+ */
+inline bool httpReadLine(WiFiClient &client, String &line, unsigned long deadline)
+{
+    line = "";
+    while ((long)(millis() - deadline) < 0)
+    {
+        if (client.available() <= 0)
+        {
+            if (!client.connected())
+                return false;
+            delay(1);
+            continue;
+        }
+        int c = client.read();
+        if (c == '\n')
+        {
+            line.trim();
+            return true;
+        }
+        if (line.length() >= HTTP_MAX_LINE)
+            return false;
+        line += (char)c;
+    }
+    return false;
+}
+
+struct QueryParam
+{
+    String key;
+    String value;
+};
+
+struct QueryParams
+{
+    QueryParam params[HTTP_MAX_PARAMS];
+    int count;
+};
+
+typedef void (*HttpHandler)(WiFiClient &client, const String &method, const String &request,
+                            const QueryParams &params, const String &jsonData);
+
+/** Returns true if it consumed the data on `client` (a socket it took over with detach()). */
+typedef bool (*ClaimHandler)(WiFiClient &client);
+
+class HttpServer
+{
+public:
+    explicit HttpServer(uint16_t port = 80) : _server(port), _routeCount(0), _claim(nullptr), _detach(false), _requests(0), _reused(0)
+    {
+        _auth[0] = '\0';
+        _realm[0] = '\0';
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; ++i)
+            _conns[i].active = false;
+    }
+
+    /** Register `handler` for requests whose path (without query) equals `path`. */
+    bool addRoute(const char *path, HttpHandler handler)
+    {
+        if (_routeCount >= HTTP_MAX_ROUTES)
+            return false;
+        _routes[_routeCount].path = path;
+        _routes[_routeCount].handler = handler;
+        _routeCount++;
+        return true;
+    }
+
+    /** Require Basic Auth with these credentials on every route. */
+    void enableAuthentication(const char *user, const char *pass, const char *realm)
+    {
+        char credentials[72];
+        snprintf(credentials, sizeof(credentials), "%s:%s", user, pass);
+        strcpy(_auth, "Basic ");
+        base64Encode((const uint8_t *)credentials, strlen(credentials), _auth + 6);
+        snprintf(_realm, sizeof(_realm), "%s", realm);
+    }
+
+    /** Expected `Authorization` header value, empty when authentication is off. */
+    const char *authorization() const { return _auth; }
+
+    /**
+     * @brief Hand the current request's connection over to the handler.
+     *
+     * Call from a handler that keeps the client (e.g. an event stream). The
+     * server releases its slot without closing the socket.
+     */
+    void detach() { _detach = true; }
+
+    /** Offer data on sockets outside the connection table to `handler` before parsing it as HTTP. */
+    void setClaimHandler(ClaimHandler handler) { _claim = handler; }
+
+    /** Start listening. WiFi must already be connected. */
+    void begin() { _server.begin(); }
+
+    /** Close idle connections and serve at most one pending request. */
+    void handleClient()
+    {
+        unsigned long now = millis();
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; ++i)
+        {
+            if (_conns[i].active && now - _conns[i].lastActivity > HTTP_IDLE_TIMEOUT)
+                drop(_conns[i]);
+        }
+
+        WiFiClient client = _server.available();
+        if (!client)
+            return;
+        Connection *conn = find(client);
+        if (conn)
+        {
+            _reused++;
+        }
+        else if (_claim && _claim(client))
+        {
+            return;
+        }
+        else
+        {
+            conn = allocate();
+            if (conn)
+            {
+                conn->client = client;
+                conn->active = true;
+                conn->requests = 0;
+            }
+        }
+        _detach = false;
+        bool keep = serve(client, conn ? conn->requests + 1 < HTTP_MAX_REQUESTS : false);
+        _requests++;
+        if (_detach)
+        {
+            if (conn)
+                conn->active = false;
+            return;
+        }
+        if (!conn)
+        {
+            client.stop();
+            return;
+        }
+        conn->requests++;
+        conn->lastActivity = millis();
+        if (!keep)
+            drop(*conn);
+    }
+
+    /** Requests served since boot. */
+    uint32_t requests() const { return _requests; }
+    /** Requests that arrived on an already open connection. */
+    uint32_t reused() const { return _reused; }
+    /** Connections currently held open. */
+    uint8_t openConnections() const
+    {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; ++i)
+            n += _conns[i].active ? 1 : 0;
+        return n;
+    }
+
+private:
+    struct Route
+    {
+        const char *path;
+        HttpHandler handler;
+    };
+
+    struct Connection
+    {
+        WiFiClient client;
+        bool active;
+        unsigned long lastActivity; ///< millis() of the last request
+        uint16_t requests;          ///< Requests served on this connection
+    };
+
+    Connection *find(const WiFiClient &client)
+    {
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; ++i)
+            if (_conns[i].active && _conns[i].client == client)
+                return &_conns[i];
+        return nullptr;
+    }
+
+    Connection *allocate()
+    {
+        for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; ++i)
+            if (!_conns[i].active)
+                return &_conns[i];
+        return nullptr;
+    }
+
+    void drop(Connection &conn)
+    {
+        conn.client.stop();
+        conn.active = false;
+    }
+
+    /**
+     * @brief Read one request from `client`, check it and run its route.
+     *
+     * `mayKeep` says whether the connection table allows another request.
+     * Returns true when the connection stays open.
+     */
+    bool serve(WiFiClient &client, bool mayKeep)
+    {
+        // One deadline for the request line and all headers, so a slow or
+        // stalled client cannot hold the loop for a timeout per line.
+        unsigned long deadline = millis() + HTTP_HEADER_DEADLINE;
+        String line;
+        if (!httpReadLine(client, line, deadline))
+            return timedOut(client);
+        int sp1 = line.indexOf(' ');
+        int sp2 = (sp1 < 0) ? -1 : line.indexOf(' ', sp1 + 1);
+        if (sp2 < 0)
+        {
+            httpKeepAlive() = false;
+            HttpResponse<0> res;
+            res.send(client, 400, "Bad Request");
+            return false;
+        }
+        String method = line.substring(0, sp1);
+        String target = line.substring(sp1 + 1, sp2);
+        bool keep = mayKeep && line.endsWith("HTTP/1.1");
+
+        String request = line + "\r\n";
+        bool authorised = _auth[0] == '\0';
+        long contentLength = 0;
+        bool ended = false;
+        // Bound the header count as well, so `request` stays small.
+        for (int i = 0; i < 32 && !ended; ++i)
+        {
+            String header;
+            if (!httpReadLine(client, header, deadline))
+                return timedOut(client);
+            if (header.length() == 0)
+            {
+                ended = true;
+                break;
+            }
+            request += header;
+            request += "\r\n";
+            int colon = header.indexOf(':');
+            if (colon < 0)
+                continue;
+            String name = header.substring(0, colon);
+            String value = header.substring(colon + 1);
+            value.trim();
+            if (name.equalsIgnoreCase("Authorization"))
+                authorised = authorised || value == _auth;
+            else if (name.equalsIgnoreCase("Connection") && value.equalsIgnoreCase("close"))
+                keep = false;
+            else if (name.equalsIgnoreCase("Content-Length"))
+                contentLength = value.toInt();
+        }
+        // Headers left unread would be taken for the next request.
+        if (!ended)
+            keep = false;
+
+        String body;
+        if (contentLength > HTTP_MAX_BODY)
+        {
+            httpKeepAlive() = false;
+            HttpResponse<0> res;
+            res.send(client, 413, "Payload Too Large");
+            return false;
+        }
+        while ((long)body.length() < contentLength)
+        {
+            if (client.available() <= 0)
+            {
+                if ((long)(millis() - deadline) >= 0 || !client.connected())
+                {
+                    // Body not sent by the deadline: the stream position is lost.
+                    keep = false;
+                    break;
+                }
+                delay(1);
+                continue;
+            }
+            body += (char)client.read();
+        }
+
+        httpKeepAlive() = keep;
+        if (!authorised)
+        {
+            char headers[64];
+            snprintf(headers, sizeof(headers), "WWW-Authenticate: Basic realm=\"%s\"\r\n", _realm);
+            HttpResponse<0> res;
+            res.send(client, 401, "Unauthorized", nullptr, headers);
+        }
+        else
+        {
+            int q = target.indexOf('?');
+            String path = (q < 0) ? target : target.substring(0, q);
+            QueryParams params;
+            params.count = 0;
+            if (q >= 0)
+                parseQuery(target.substring(q + 1), params);
+            HttpHandler handler = nullptr;
+            for (uint8_t i = 0; i < _routeCount; ++i)
+                if (path == _routes[i].path)
+                    handler = _routes[i].handler;
+            if (handler)
+            {
+                handler(client, method, request, params, body);
+            }
+            else
+            {
+                HttpResponse<0> res;
+                res.send(client, 404, "Not Found");
+            }
+        }
+        keep = httpKeepAlive();
+        httpKeepAlive() = false;
+        return keep;
+    }
+
+    /** Answer 408 to a request that did not arrive by its deadline; the connection is closed. */
+    static bool timedOut(WiFiClient &client)
+    {
+        httpKeepAlive() = false;
+        if (client.connected())
+        {
+            HttpResponse<0> res;
+            res.send(client, 408, "Request Timeout");
+        }
+        return false;
+    }
+
+    /** Split `query` into key/value pairs, decoding `+` and `%XX`. */
+    static void parseQuery(const String &query, QueryParams &params)
+    {
+        int start = 0;
+        while (start < (int)query.length() && params.count < HTTP_MAX_PARAMS)
+        {
+            int amp = query.indexOf('&', start);
+            String pair = query.substring(start, amp < 0 ? query.length() : amp);
+            int eq = pair.indexOf('=');
+            QueryParam &p = params.params[params.count++];
+            p.key = decode(eq < 0 ? pair : pair.substring(0, eq));
+            p.value = eq < 0 ? String("") : decode(pair.substring(eq + 1));
+            if (amp < 0)
+                break;
+            start = amp + 1;
+        }
+    }
+
+    static String decode(const String &in)
+    {
+        String out;
+        for (unsigned i = 0; i < in.length(); ++i)
+        {
+            char c = in[i];
+            if (c == '+')
+            {
+                out += ' ';
+            }
+            else if (c == '%' && i + 2 < in.length())
+            {
+                char hex[3] = {in[i + 1], in[i + 2], '\0'};
+                out += (char)strtol(hex, nullptr, 16);
+                i += 2;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    WiFiServer _server;
+    Route _routes[HTTP_MAX_ROUTES];
+    uint8_t _routeCount;
+    ClaimHandler _claim;
+    bool _detach; ///< Set by detach() during the current request
+    Connection _conns[HTTP_MAX_CONNECTIONS];
+    char _auth[104]; ///< "Basic " + base64 of "user:pass"
+    char _realm[32];
+    uint32_t _requests;
+    uint32_t _reused;
+};
@@ -13,12 +13,13 @@ const char* INDEX_PAGE = R"rawliteral(
     <div class="card shadow-sm rounded mx-auto overflow-hidden" style="max-width:520px;">
         <div class="d-flex p-3 gap-3 align-items-center bg-light border-bottom">
             <div class="flex-shrink-0 bg-secondary overflow-hidden rounded" style="width:160px;height:120px;">
-                <img id="cam" src="/image?t=0" alt="Camera" style="width:100%;height:100%;object-fit:cover;display:block;" />
+                <img id="cam" alt="Camera" style="width:100%;height:100%;object-fit:cover;display:block;" />
             </div>
             <div class="flex-grow-1">
                 <h5 class="mb-1">Smart Agriculture System</h5>
                 <div class="text-muted small" id="wifi">Loading…</div>
                 <div class="text-muted small" id="datetime">Loading…</div>
+                <a class="small" id="live" target="_blank" rel="noopener">Live video</a>
             </div>
         </div>
         <ul class="list-group list-group-flush">
@@ -43,6 +44,17 @@ const char* INDEX_PAGE = R"rawliteral(
                 <span class="text-muted small">Pump</span>
                 <span id="pump" class="fw-semibold">Loading…</span>
             </li>
+            <li class="list-group-item d-flex justify-content-between align-items-center">
+                <div>
+                    <span class="text-muted small">Pump mode</span>
+                    <div id="modeStatus" class="small text-muted"></div>
+                </div>
+                <div class="btn-group btn-group-sm" role="group" aria-label="Pump mode">
+                    <button type="button" class="btn btn-outline-primary" data-mode="auto" disabled>Auto</button>
+                    <button type="button" class="btn btn-outline-primary" data-mode="on" disabled>On</button>
+                    <button type="button" class="btn btn-outline-primary" data-mode="off" disabled>Off</button>
+                </div>
+            </li>
             <li class="list-group-item d-flex justify-content-between align-items-center">
                 <span class="text-muted small">Camera detection</span>
                 <span id="camera" class="fw-semibold">Loading…</span>
@@ -54,81 +66,169 @@ const char* INDEX_PAGE = R"rawliteral(
 </div>
 
 <script>
-// Fetch and display status/time/sensor values
-async function fetchStatus(){
-    try{
-        const r = await fetch('/status');
-        const j = await r.json();
-        document.getElementById('wifi').textContent = j.connected ? ('Connected: ' + j.ip) : 'Not connected';
-        if (typeof j.cameraDetected !== 'undefined') {
-            document.getElementById('camera').textContent = j.cameraDetected ? 'Successful' : 'Unsuccessful';
-        } else if (typeof j.camera !== 'undefined') {
-            document.getElementById('camera').textContent = j.camera ? 'Successful' : 'Unsuccessful';
-        }
-    }catch(e){
-        document.getElementById('wifi').textContent = 'Error';
+// Live MJPEG stream is served on its own port
+document.getElementById('live').href = location.protocol + '//' + location.hostname + ':81/stream';
+
+// Status, sensor readings, time and frame metadata from /api/snapshot and /events
+const $ = id => document.getElementById(id);
+
+function showStatus(j){
+    $('wifi').textContent = j.connected ? ('Connected: ' + j.ip) : 'Not connected';
+    const cam = { ok: 'Successful', recovering: 'Recovering' }[j.camera];
+    $('camera').textContent = cam || (j.cameraDetected ? 'Offline' : 'Unsuccessful');
+}
+
+function showSensor(j){
+    $('temp').textContent = j.temperature !== null ? (j.temperature + ' °C') : 'N/A';
+    $('hum').textContent = j.humidity !== null ? (j.humidity + ' %') : 'N/A';
+    $('level').textContent = j.level !== null ? (j.level + ' %') : 'N/A';
+    $('pump').textContent = j.pump !== null ? (j.pump ? 'On' : 'Off') : 'N/A';
+    if (j.mode) showMode(j.mode);
+
+    // Temperature status: show warning from server or indicate Good
+    const statusEl = $('tempStatus');
+    if (j.warning !== null && typeof j.warning !== 'undefined') {
+        statusEl.textContent = j.warning;
+        statusEl.classList.remove('text-success');
+        statusEl.classList.add('text-danger');
+    } else if (j.temperature === null) {
+        statusEl.textContent = 'N/A';
+        statusEl.classList.remove('text-danger');
+        statusEl.classList.add('text-muted');
+    } else {
+        statusEl.textContent = 'Good';
+        statusEl.classList.remove('text-danger');
+        statusEl.classList.remove('text-muted');
+        statusEl.classList.add('text-success');
     }
 }
-fetchStatus();
 
-async function fetchTime(){
+// Pump mode buttons: the active mode is highlighted; commands go over /ws,
+// so the buttons are only enabled while the WebSocket is open
+const modeButtons = document.querySelectorAll('[data-mode]');
+function showMode(mode){
+    modeButtons.forEach(b => {
+        b.classList.toggle('active', b.dataset.mode === mode);
+    });
+}
+function enableModes(on){
+    modeButtons.forEach(b => { b.disabled = !on; });
+    $('modeStatus').textContent = on ? '' : 'Controls offline';
+}
+
+// Arducam image — fetched only when the device reports a new frame
+// sequence number, so an unchanged scene costs no image request at all
+let lastFrameSeq = null;
+let imageBusy = false;
+async function fetchImage(seq){
+    if (imageBusy) return;
+    imageBusy = true;
     try{
-        const r = await fetch('/time');
-        const j = await r.json();
-        document.getElementById('datetime').textContent = j.datetime || 'N/A';
+        const r = await fetch('/image', {cache: 'no-cache'});
+        if (r.status !== 200) return;
+        lastFrameSeq = seq;
+        const img = $('cam');
+        const old = img.src;
+        img.src = URL.createObjectURL(await r.blob());
+        if (old.startsWith('blob:')) URL.revokeObjectURL(old);
     }catch(e){
-        document.getElementById('datetime').textContent = 'Error';
+        // ignore image fetch errors
+    }finally{
+        imageBusy = false;
     }
 }
-fetchTime();
-setInterval(fetchTime, 60000);
 
-async function fetchSensor(){
+function showTime(j){
+    $('datetime').textContent = (j && j.datetime) || 'N/A';
+}
+
+function showFrame(f){
+    if (f && f.valid && f.seq !== lastFrameSeq) fetchImage(f.seq);
+}
+
+async function fetchSnapshot(){
     try{
-        const r = await fetch('/sensor');
+        const r = await fetch('/api/snapshot', {cache: 'no-store'});
         const j = await r.json();
-        document.getElementById('temp').textContent = j.temperature !== null ? (j.temperature + ' °C') : 'N/A';
-        document.getElementById('hum').textContent = j.humidity !== null ? (j.humidity + ' %') : 'N/A';
-        document.getElementById('level').textContent = j.level !== null ? (j.level + ' %') : 'N/A';
-        document.getElementById('pump').textContent = j.pump !== null ? (j.pump ? 'On' : 'Off') : 'N/A';
-
-        // Temperature status: show warning from server or indicate Good
-        const statusEl = document.getElementById('tempStatus');
-        if (j.warning !== null && typeof j.warning !== 'undefined') {
-            statusEl.textContent = j.warning;
-            statusEl.classList.remove('text-success');
-            statusEl.classList.add('text-danger');
-        } else if (j.temperature === null) {
-            statusEl.textContent = 'N/A';
-            statusEl.classList.remove('text-danger');
-            statusEl.classList.add('text-muted');
-        } else {
-            statusEl.textContent = 'Good';
-            statusEl.classList.remove('text-danger');
-            statusEl.classList.remove('text-muted');
-            statusEl.classList.add('text-success');
-        }
+        showStatus(j.status);
+        showSensor(j.sensor);
+        showTime(j.time);
+        showFrame(j.frame);
     }catch(e){
-        document.getElementById('temp').textContent = 'Error';
-        document.getElementById('hum').textContent = 'Error';
-        document.getElementById('pump').textContent = 'Error';
-    }
+        $('wifi').textContent = 'Error';
+        $('temp').textContent = 'Error';
+        $('hum').textContent = 'Error';
+        $('pump').textContent = 'Error';
     }
-    fetchSensor();
-    setInterval(fetchSensor, 5000);
-
-    // Arducam image fetch — refresh periodically to update preview
-    async function fetchImage(){
-        try{
-            const timestamp = Date.now();
-            document.getElementById('cam').src = '/image?t=' + timestamp;
-        }catch(e){
-            // ignore image fetch errors
-        }
-    }
-    // initial load and periodic refresh every 5 seconds
-    fetchImage();
-    setInterval(fetchImage, 5000);
+}
+
+// Binary telemetry frame from /ws (12 bytes, little-endian); see README
+const MODES = ['auto', 'on', 'off'];
+function showTelemetry(buf){
+    const d = new DataView(buf);
+    if (d.byteLength < 12 || d.getUint8(0) !== 1) return;
+    const flags = d.getUint8(1);
+    const mode = MODES[d.getUint8(2)] || 'auto';
+    showSensor({
+        temperature: (flags & 2) ? d.getInt16(4, true) / 10 : null,
+        humidity: (flags & 4) ? d.getUint8(3) : null,
+        level: (flags & 8) ? d.getUint8(6) : null,
+        pump: ((flags & 8) || mode !== 'auto') ? !!(flags & 1) : null,
+        warning: (flags & 16) ? 'High temperature (>30°C)' : null,
+        mode: mode
+    });
+    const seq = d.getUint32(8, true);
+    showFrame({valid: seq !== 0, seq: seq});
+}
+
+// Full state once, then the device pushes changes: over /ws when it can,
+// which also carries pump commands, otherwise on /events. Only the
+// slow-moving status (WiFi, camera health) and the clock are still polled,
+// once a minute. A WebSocket that drops is reopened after 5 seconds; if it
+// cannot be opened at all, use /events, and without either, poll the
+// snapshot every 5 seconds.
+let pollTimer = null;
+function startPolling(){
+    if (pollTimer !== null) clearInterval(pollTimer);
+    pollTimer = setInterval(fetchSnapshot, 5000);
+}
+
+function startEvents(){
+    if (!window.EventSource) { startPolling(); return; }
+    const es = new EventSource('/events');
+    es.addEventListener('sensor', e => showSensor(JSON.parse(e.data)));
+    es.addEventListener('frame', e => showFrame(JSON.parse(e.data)));
+    es.addEventListener('time', e => showTime(JSON.parse(e.data)));
+    es.onerror = () => { if (es.readyState === EventSource.CLOSED) startPolling(); };
+}
+
+let socket = null;
+function startSocket(){
+    const ws = new WebSocket((location.protocol === 'https:' ? 'wss://' : 'ws://') + location.host + '/ws');
+    ws.binaryType = 'arraybuffer';
+    let opened = false;
+    ws.onopen = () => { opened = true; socket = ws; enableModes(true); };
+    ws.onmessage = e => {
+        if (typeof e.data === 'string') $('modeStatus').textContent = e.data;
+        else showTelemetry(e.data);
+    };
+    ws.onclose = () => {
+        socket = null;
+        enableModes(false);
+        if (opened) setTimeout(startSocket, 5000);
+        else startEvents();
+    };
+}
+
+modeButtons.forEach(b => b.addEventListener('click', () => {
+    if (socket && socket.readyState === WebSocket.OPEN) socket.send(b.dataset.mode);
+}));
+
+fetchSnapshot();
+enableModes(false);
+pollTimer = setInterval(fetchSnapshot, 60000);
+if (window.WebSocket) startSocket();
+else startEvents();
 </script>
 </body>
 </html>
@@ -9,6 +9,7 @@
  *  - I2C LCD status display
  *  - DHT temperature/humidity sensor
  *  - Analogue water level sensor controlling a relay-driven pump
+ *  - Optional ArduCAM OV2640 JPEG frames published as MQTT fragments
  *
  * Provide Wi-Fi and secrets in `arduino_secrets.h`:
  *   - SECRET_SSID, SECRET_PASS
@@ -27,6 +28,15 @@
 #include <DHT.h>
 // MQTT telemetry and control
 #include <PubSubClient.h>
+// Camera (ArduCAM Mini OV2640), optional
+#define OV2640_MINI_2MP
+#include <SPI.h>
+#include "memorysaver.h"
+#include <ArduCAM.h>
+#include "camera_pipeline.h"
+#include "scene_change.h"
+#include "canopy_analyser.h"
+#include "camera_health.h"
 
 /** === Configuration === */
 // Wi‑Fi credentials are kept in `arduino_secrets.h` (excluded from version control).
@@ -89,18 +99,75 @@ bool lastPumpOn = false;
 
 /** === Pump control mode === */
 /** Pump may be controlled automatically based on level, or forced on/off via MQTT. */
-enum PumpMode
+#include "pump_control.h"
+PumpMode pumpMode = MODE_AUTO;
+
+/** === ArduCAM configuration === */
+/** SPI pins: SCK=D13 MISO=D12 MOSI=D11 CS=D10. */
+#define CAM_CS_PIN 10
+ArduCAM myCAM(OV2640, CAM_CS_PIN);
+/** Set when the camera answers the SPI test at start-up. */
+bool cameraEnabled = false;
+/** Re-probes the camera while idle and re-initialises it after a brown-out; cameraEnabled follows it. */
+CameraHealth cameraHealth(myCAM);
+/** Capture completion timeout. */
+const unsigned long CAPTURE_TIMEOUT = 2000;
+/** Capture, JPEG framing and FIFO read-out; also counts dropped frames. */
+CameraPipeline camera(myCAM, CAPTURE_TIMEOUT);
+
+/** === Image publishing === */
+/**
+ * A JPEG is far larger than PubSubClient's packet buffer, so each frame is
+ * published as a JSON manifest on `<base>/image/<seq>/manifest` followed by
+ * fragments on `<base>/image/<seq>/<n>` (n = 0 .. fragments-1). Fragments
+ * are streamed from the camera FIFO with beginPublish()/write()/endPublish(),
+ * so no frame buffer is needed.
+ *
+ * One fragment is sent per loop pass at most, and only while the byte
+ * budget allows: the budget refills at IMAGE_RATE_BPS and holds at most
+ * IMAGE_MAX_INFLIGHT fragments, which bounds how much image data can be
+ * queued ahead of telemetry. PubSubClient publishes at QoS 0, so there is
+ * no broker acknowledgement to count instead.
+ */
+const unsigned long IMAGE_INTERVAL = 60000;
+const uint16_t IMAGE_FRAGMENT_SIZE = 1024;
+const uint8_t IMAGE_MAX_INFLIGHT = 2;
+const uint32_t IMAGE_RATE_BPS = 4096;
+/** Unchanged scenes (JPEG size within 2%) are not published, but a frame is sent at least every 15 minutes. */
+SceneChangeDetector sceneDetector(20, 15UL * 60000);
+
+/**
+ * Canopy cover is measured every CANOPY_INTERVAL from an RGB565 frame
+ * (canopy_analyser.h) and sent as the `canopy` field of the sensor JSON,
+ * which is published as soon as a measurement completes.
+ */
+const unsigned long CANOPY_INTERVAL = 5UL * 60000;
+/** FIFO bytes analysed per loop pass. */
+const uint32_t CANOPY_SLICE = 2048;
+
+enum ImageState
 {
-    MODE_AUTO,     ///< Automatic: use hysteresis logic based on water level
-    MODE_FORCE_ON, ///< Forced on: pump controlled via MQTT command
-    MODE_FORCE_OFF ///< Forced off: pump controlled via MQTT command
+    IMG_IDLE,       ///< Waiting for IMAGE_INTERVAL or CANOPY_INTERVAL
+    IMG_TRIGGERED,  ///< Sensor is writing a frame into the FIFO
+    IMG_PUBLISHING, ///< Manifest sent; fragments are read from the FIFO in burst mode
+    IMG_CANOPY      ///< canopyProbe owns the camera (RGB565 capture and analysis)
 };
-PumpMode pumpMode = MODE_AUTO;
+ImageState imageState = IMG_IDLE;
+uint32_t imageSeq = 0;          ///< Sequence number of the frame being (or last) published
+uint32_t imageRemaining = 0;    ///< JPEG bytes not yet published
+uint16_t imageFragment = 0;     ///< Index of the next fragment
+unsigned long lastImageAt = 0;
+uint32_t imageTokens = 0;       ///< Byte budget for fragments (token bucket)
+unsigned long imageTokensAt = 0;
+CanopyProbe canopyProbe(myCAM, camera);
+unsigned long lastCanopyAt = 0;
 
 /** === MQTT client === */
 /** Network client and MQTT broker interface. */
 WiFiClient netClient;
 PubSubClient mqtt(netClient);
+/** Image fragments are written to the MQTT connection straight from the pipeline buffer. */
+PrintSink mqttSink(mqtt);
 
 /** === Device identity === */
 /** Derived from MAC address; used to construct MQTT topic hierarchy. */
@@ -138,6 +205,11 @@ void publishSensor(bool retained = false);
  */
 void publishPumpState(bool retained = true);
 
+/**
+ * @brief Advance image capture and publishing by one step. Never blocks for long.
+ */
+void imageTick();
+
 /**
  * @brief Initialize device identity (MAC address) for MQTT topics.
  */
@@ -247,6 +319,10 @@ void publishStatus(bool retained)
     snprintf(ipTopic, sizeof(ipTopic), "%s/status/ip", topicBase);
     snprintf(ipBuf, sizeof(ipBuf), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     mqtt.publish(ipTopic, ipBuf, true);
+
+    // Camera health: ok, recovering or offline (retained)
+    snprintf(topic, sizeof(topic), "%s/status/camera", topicBase);
+    mqtt.publish(topic, cameraHealth.status(), true);
 }
 
 /**
@@ -266,8 +342,9 @@ void publishPumpState(bool retained)
  * Publishes sensor readings and device state as a JSON payload to MQTT.
  *
  * JSON fields: temperature (float °C), humidity (percent), level (percent),
- * pump (boolean), mode (string: auto/on/off), and time (HH:MM).
- * Null values are used when sensors are unavailable.
+ * pump (boolean), mode (string: auto/on/off), time (HH:MM) and canopy (latest
+ * canopy measurement, see `canopyFormatJson()`).
+ * Null values are used when sensors or measurements are unavailable.
  */
 void publishSensor(bool retained)
 {
@@ -280,8 +357,8 @@ void publishSensor(bool retained)
     formatLocalTime(timeStr, sizeof(timeStr));
 
     // Build JSON payload with all sensor readings and pump/mode state
-    char payload[192];
-    const char *modeStr = (pumpMode == MODE_AUTO) ? "auto" : (pumpMode == MODE_FORCE_ON ? "on" : "off");
+    char payload[320];
+    const char *modeStr = pumpModeName(pumpMode);
     // Handle nulls for missing values for temperature, humidity, and water level
     char tempBuf[12];
     char humBuf[12];
@@ -293,49 +370,187 @@ void publishSensor(bool retained)
         strcpy(humBuf, "null");
     else
         dtostrf(lastHum, 0, 0, humBuf);
+    char canopyBuf[160];
+    canopyFormatJson(canopyBuf, sizeof(canopyBuf), canopyProbe.result(), millis());
 
     if (lastLevel < 0)
     {
         snprintf(payload, sizeof(payload),
-                 "{\"temperature\":%s,\"humidity\":%s,\"level\":null,\"pump\":%s,\"mode\":\"%s\",\"time\":\"%s\"}",
-                 tempBuf, humBuf, lastPumpOn ? "true" : "false", modeStr, timeStr);
+                 "{\"temperature\":%s,\"humidity\":%s,\"level\":null,\"pump\":%s,\"mode\":\"%s\",\"time\":\"%s\","
+                 "\"canopy\":%s}",
+                 tempBuf, humBuf, lastPumpOn ? "true" : "false", modeStr, timeStr, canopyBuf);
     }
     else
     {
         snprintf(payload, sizeof(payload),
-                 "{\"temperature\":%s,\"humidity\":%s,\"level\":%d,\"pump\":%s,\"mode\":\"%s\",\"time\":\"%s\"}",
-                 tempBuf, humBuf, lastLevel, lastPumpOn ? "true" : "false", modeStr, timeStr);
+                 "{\"temperature\":%s,\"humidity\":%s,\"level\":%d,\"pump\":%s,\"mode\":\"%s\",\"time\":\"%s\","
+                 "\"canopy\":%s}",
+                 tempBuf, humBuf, lastLevel, lastPumpOn ? "true" : "false", modeStr, timeStr, canopyBuf);
     }
     mqtt.publish(topic, payload, retained);
 }
 
 /**
- * @brief Handle incoming MQTT messages on subscribed topics.
- *
- * Processes pump control commands from the pump/cmd topic. Accepts commands:
- * "auto", "on", or "off" to set the pump mode. After processing, publishes
- * the updated state and sensor data back to the broker.
+ * Publishes the manifest of the frame held in the FIFO as JSON:
+ * seq, size (bytes), fragments, fragmentSize, crc (CRC-32 of the JPEG, hex),
+ * epoch (NTP capture time, 0 if unsynchronised), and the dropped/unchanged
+ * frame counters.
  */
-void mqttCallback(char *topic, byte *payload, unsigned int length)
+bool publishImageManifest(uint32_t length, uint32_t crc, unsigned long epoch)
 {
-    // Copy and null-terminate the payload for string comparison
-    char buf[16];
-    unsigned int n = (length < sizeof(buf) - 1) ? length : sizeof(buf) - 1;
-    memcpy(buf, payload, n);
-    buf[n] = '\0';
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/image/%lu/manifest", topicBase, (unsigned long)imageSeq);
+    uint16_t fragments = (length + IMAGE_FRAGMENT_SIZE - 1) / IMAGE_FRAGMENT_SIZE;
+    char payload[192];
+    snprintf(payload, sizeof(payload),
+             "{\"seq\":%lu,\"size\":%lu,\"fragments\":%u,\"fragmentSize\":%u,\"crc\":\"%08lx\",\"epoch\":%lu,"
+             "\"dropped\":%lu,\"unchanged\":%lu}",
+             (unsigned long)imageSeq, (unsigned long)length, fragments, IMAGE_FRAGMENT_SIZE, (unsigned long)crc, epoch,
+             (unsigned long)camera.framer().dropped(), (unsigned long)sceneDetector.unchanged());
+    return mqtt.publish(topic, payload, false);
+}
+
+/**
+ * Streams the next fragment from the FIFO (already open in burst mode) to
+ * the broker. Returns false when the connection failed mid-frame.
+ */
+bool publishImageFragment()
+{
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/image/%lu/%u", topicBase, (unsigned long)imageSeq, imageFragment);
+    uint16_t len = (imageRemaining > IMAGE_FRAGMENT_SIZE) ? IMAGE_FRAGMENT_SIZE : imageRemaining;
+    if (!mqtt.beginPublish(topic, len, false))
+        return false;
+    if (camera.read(mqttSink, len) != len || !mqtt.endPublish())
+        return false;
+    imageRemaining -= len;
+    imageFragment++;
+    return true;
+}
 
-    if (strcmp(buf, "auto") == 0)
+/**
+ * Capture runs as a small state machine so sensor reads, pump control and
+ * MQTT keep-alives continue while a frame is captured and published.
+ */
+void imageTick()
+{
+    if (imageState == IMG_CANOPY)
     {
-        pumpMode = MODE_AUTO;
+        // Runs to completion even while disconnected so the sensor is put back into JPEG mode.
+        if (canopyProbe.tick(CANOPY_SLICE))
+            publishSensor(false);
+        if (!canopyProbe.busy())
+            imageState = IMG_IDLE;
+        return;
     }
-    else if (strcmp(buf, "on") == 0)
+    if (imageState == IMG_IDLE)
     {
-        pumpMode = MODE_FORCE_ON;
+        // Health checks and recovery touch the camera, so only run them between captures.
+        if (cameraHealth.tick())
+            myCAM.OV2640_set_JPEG_size(OV2640_320x240);
+        if (cameraEnabled != cameraHealth.ok())
+        {
+            cameraEnabled = cameraHealth.ok();
+            Serial.println(cameraEnabled ? "camera: recovered" : "camera: not responding, recovering");
+            publishStatus(true);
+        }
     }
-    else if (strcmp(buf, "off") == 0)
+    if (!cameraEnabled || !mqtt.connected())
     {
-        pumpMode = MODE_FORCE_OFF;
+        if (imageState == IMG_PUBLISHING)
+        {
+            // Connection lost mid-frame; the host reports the missing fragments.
+            camera.close();
+            camera.release();
+            imageState = IMG_IDLE;
+        }
+        return;
     }
+    unsigned long now = millis();
+
+    switch (imageState)
+    {
+    case IMG_IDLE:
+        if (lastCanopyAt == 0 || now - lastCanopyAt >= CANOPY_INTERVAL)
+        {
+            lastCanopyAt = now;
+            canopyProbe.start(OV2640_320x240);
+            imageState = IMG_CANOPY;
+            return;
+        }
+        if (lastImageAt != 0 && now - lastImageAt < IMAGE_INTERVAL)
+            return;
+        lastImageAt = now;
+        camera.trigger();
+        imageState = IMG_TRIGGERED;
+        break;
+    case IMG_TRIGGERED:
+    {
+        if (!camera.ready())
+            return;
+        CaptureResult result = camera.finish();
+        // Timeouts read as empty; several in a row mean the camera needs recovering.
+        cameraHealth.recordCapture(result != CAPTURE_EMPTY);
+        if (result != CAPTURE_OK || camera.frame() != CAPTURE_OK ||
+            !sceneDetector.changed(camera.length(), now))
+        {
+            camera.release();
+            imageState = IMG_IDLE;
+            return;
+        }
+        imageSeq++;
+        imageRemaining = camera.length();
+        imageFragment = 0;
+        if (!publishImageManifest(imageRemaining, camera.crc(), timeClient.getEpochTime()))
+        {
+            camera.release();
+            imageState = IMG_IDLE;
+            return;
+        }
+        camera.open(camera.start());
+        imageTokens = IMAGE_FRAGMENT_SIZE;
+        imageTokensAt = now;
+        imageState = IMG_PUBLISHING;
+        break;
+    }
+    case IMG_PUBLISHING:
+    {
+        // Refill the byte budget, capped at IMAGE_MAX_INFLIGHT fragments.
+        const uint32_t cap = (uint32_t)IMAGE_MAX_INFLIGHT * IMAGE_FRAGMENT_SIZE;
+        uint32_t refill = (uint32_t)((now - imageTokensAt) * IMAGE_RATE_BPS / 1000);
+        if (refill)
+        {
+            imageTokens = (imageTokens + refill > cap) ? cap : imageTokens + refill;
+            imageTokensAt = now;
+        }
+        uint16_t next = (imageRemaining > IMAGE_FRAGMENT_SIZE) ? IMAGE_FRAGMENT_SIZE : imageRemaining;
+        if (imageTokens < next)
+            return;
+        imageTokens -= next;
+        if (!publishImageFragment() || imageRemaining == 0)
+        {
+            camera.close();
+            camera.release();
+            imageState = IMG_IDLE;
+        }
+        break;
+    }
+    case IMG_CANOPY:
+        break;
+    }
+}
+
+/**
+ * @brief Handle incoming MQTT messages on subscribed topics.
+ *
+ * Processes pump control commands from the pump/cmd topic. Accepts commands:
+ * "auto", "on", or "off" to set the pump mode. After processing, publishes
+ * the updated state and sensor data back to the broker.
+ */
+void mqttCallback(char *topic, byte *payload, unsigned int length)
+{
+    // Unknown commands leave the mode unchanged
+    pumpModeParse((const char *)payload, length, pumpMode);
 
     // Publish updated state after command
     publishPumpState(true);
@@ -366,6 +581,28 @@ void setup()
     lcd.setCursor(0, 0);
     lcd.print("Starting...");
 
+    // The camera is optional: publish images only when it answers the SPI test.
+    pinMode(CAM_CS_PIN, OUTPUT);
+    digitalWrite(CAM_CS_PIN, HIGH);
+    SPI.begin();
+    delay(100);
+    myCAM.write_reg(ARDUCHIP_TEST1, 0x55);
+    if (myCAM.read_reg(ARDUCHIP_TEST1) == 0x55)
+    {
+        myCAM.set_format(JPEG);
+        myCAM.InitCAM();
+        myCAM.OV2640_set_JPEG_size(OV2640_320x240);
+        myCAM.clear_fifo_flag();
+        cameraEnabled = true;
+        Serial.println("ArduCAM initialised (JPEG 320x240)");
+    }
+    else
+    {
+        Serial.println("Camera not present, image publishing disabled");
+    }
+    // A missing camera is probed again in the background and brought up if it appears.
+    cameraHealth.begin(cameraEnabled);
+
     dht.begin();
     pinMode(RELAY_PIN, OUTPUT);
     if (RELAY_ACTIVE_HIGH)
@@ -397,6 +634,7 @@ void loop()
     ensureWifi();
     ensureMqtt();
     mqtt.loop();
+    imageTick();
 
     unsigned long now = millis();
     if (now - lastDisplay >= displayInterval)
@@ -418,33 +656,8 @@ void loop()
             level = 100;
         lastLevel = level;
 
-        // Determine pump state based on control mode
-        bool pumpOn = false;
-        if (pumpMode == MODE_FORCE_ON)
-        {
-            pumpOn = true;
-        }
-        else if (pumpMode == MODE_FORCE_OFF)
-        {
-            pumpOn = false;
-        }
-        else
-        {
-            // MODE_AUTO: use hysteresis to prevent rapid toggling
-            if (lastLevel >= 0)
-            {
-                if (!lastPumpOn)
-                {
-                    // Currently off: turn on when level falls strictly below target
-                    pumpOn = (lastLevel < SECRET_TARGET_LEVEL);
-                }
-                else
-                {
-                    // Currently on: stay on until level rises above target + hysteresis
-                    pumpOn = (lastLevel <= (SECRET_TARGET_LEVEL + PUMP_HYSTERESIS));
-                }
-            }
-        }
+        // Determine pump state based on control mode (hysteresis in automatic mode)
+        bool pumpOn = pumpDecide(pumpMode, lastLevel, lastPumpOn, SECRET_TARGET_LEVEL, PUMP_HYSTERESIS);
         lastPumpOn = pumpOn;
 
         // Drive relay according to pump state (respect RELAY_ACTIVE_HIGH).
@@ -3,12 +3,13 @@
  * @brief Firmware for the IoT Agriculture device.
  *
  * Features:
- *  - WiFi web dashboard (UnoR4WiFi_WebServer)
+ *  - WiFi web dashboard (HTTP/1.1 with persistent connections)
  *  - NTP-based timekeeping
  *  - I2C LCD status display
  *  - DHT temperature/humidity sensor
  *  - Analogue water level sensor to control a relay-driven pump
  *  - ArduCAM OV2640 on-demand JPEG snapshot streaming
+ *  - MJPEG video stream on port 81 (`/stream`)
  *
  * Important configuration constants and hardware pins are defined in this
  * file. Use `arduino_secrets.h` to provide WiFi and basic-auth credentials.
@@ -28,11 +29,27 @@
 #include <SPI.h>
 #include "memorysaver.h"
 #include <ArduCAM.h>
+#include "camera_pipeline.h"
+#include "resolution_controller.h"
+#include "scene_change.h"
+#include "canopy_analyser.h"
+#include "camera_health.h"
+#include "camera_stats.h"
+#include "http_response.h"
 
 /** === HTTP server === */
-/** Use the Uno R4 webserver library for routes and authentication. */
-#include <UnoR4WiFi_WebServer.h>
-UnoR4WiFi_WebServer server;
+/**
+ * Routes and Basic Auth, with persistent (keep-alive) connections so the
+ * dashboard's polls do not each open a new socket over the WiFi bridge.
+ */
+#include "http_server.h"
+HttpServer server;
+/** Live readings pushed to dashboards on `/events` (Server-Sent Events). */
+#include "event_stream.h"
+EventStream events;
+/** Binary telemetry and pump commands for dashboards on `/ws` (WebSocket). */
+#include "websocket.h"
+WebSocketHub ws;
 /** Provide dashboard HTML via `index_page.h` */
 #include "index_page.h"
 
@@ -78,6 +95,9 @@ int lastLevel = -1;
 #define RELAY_ACTIVE_HIGH 1
 /** Store recent pump state for the web UI */
 bool lastPumpOn = false;
+/** Automatic (level hysteresis) or forced by a `/ws` command; see `pump_control.h`. */
+#include "pump_control.h"
+PumpMode pumpMode = MODE_AUTO;
 /** Hysteresis (percent) to prevent rapid pump toggling around threshold. */
 #ifndef SECRET_PUMP_HYSTERESIS
 const int PUMP_HYSTERESIS = 5;
@@ -95,12 +115,157 @@ ArduCAM myCAM(OV2640, CAM_CS_PIN);
 bool cameraEnabled = false;
 // Record whether a camera was detected during initialisation
 bool cameraDetectedAtInit = false;
+// Re-probes the camera while idle and re-initialises it after a brown-out;
+// cameraEnabled follows it once setup() is done.
+CameraHealth cameraHealth(myCAM);
 
 /** === Camera streaming configuration === */
-/** Set a small per-chunk buffer for camera streaming (working around the large RAM buffer issues in testing). */
-const size_t CAM_CHUNK = 64;
-/** Safety upper bound for streamed frames (does not allocate this RAM). */
-const uint32_t MAX_STREAM_BYTES = 32768; // 32 KB safety bound
+/**
+ * Upper bound for streamed frames: the ArduCAM FIFO size. Frames are sent
+ * with chunked transfer encoding straight from the FIFO, so this does not
+ * allocate RAM.
+ */
+const uint32_t MAX_FIFO = CameraPipeline::MAX_FIFO;
+/** Set to 1 to log per-frame streaming throughput to Serial. */
+#ifndef CAM_LOG_THROUGHPUT
+#define CAM_LOG_THROUGHPUT 0
+#endif
+
+/** === Adaptive resolution === */
+/**
+ * Steps the JPEG size along the OV2640 ladder to keep capture + transfer
+ * near ADAPTIVE_TARGET_MS, starting from 320x240. Set ADAPTIVE_RESOLUTION
+ * to 0 to pin the start size.
+ */
+#ifndef ADAPTIVE_RESOLUTION
+#define ADAPTIVE_RESOLUTION 1
+#endif
+const unsigned long ADAPTIVE_TARGET_MS = 2000;
+// Keep headroom below the FIFO size since JPEG size varies with the scene.
+ResolutionController resolution(2, RESOLUTION_STEPS - 1, ADAPTIVE_TARGET_MS, MAX_FIFO / 2);
+
+/** === Frame cache === */
+/**
+ * The most recent JPEG is kept in the ArduCAM FIFO itself (the board has no
+ * RAM to spare for a frame); only its metadata is held here. Every `/image`
+ * request re-reads the FIFO from the start, so any number of viewers cost a
+ * single capture per refresh interval.
+ */
+struct FrameCache
+{
+    bool valid;                  ///< FIFO holds a complete frame described below
+    uint32_t seq;                ///< Increments when a capture shows a changed scene (used as the ETag)
+    uint32_t offset;             ///< Offset of the JPEG SOI within the FIFO
+    uint32_t length;             ///< Exact JPEG length, SOI to EOI
+    unsigned long capturedAt;    ///< millis() when the capture completed
+    unsigned long capturedEpoch; ///< NTP epoch when the capture completed (0 if unsynchronised)
+};
+FrameCache frameCache = {false, 0, 0, 0, 0, 0};
+
+/** Outcome of the most recent capture, so `/image` can report why no frame is cached. */
+CaptureResult lastCaptureResult = CAPTURE_EMPTY;
+
+/** Capture-ahead interval while viewers are active. Matches the dashboard refresh. */
+const unsigned long FRAME_REFRESH_INTERVAL = 5000;
+/** Stop capturing ahead when no `/image` request has arrived for this long. */
+const unsigned long FRAME_VIEWER_TIMEOUT = 30000;
+/** Capture completion timeout. */
+const unsigned long CAPTURE_TIMEOUT = 2000;
+/** FIFO bytes scanned for JPEG markers per `cameraTick()` while framing. */
+const uint32_t FRAMING_SLICE = 4 * CAM_BURST_CHUNK;
+
+/** Captures, frames (counting dropped frames) and reads out the FIFO for every client. */
+CameraPipeline camera(myCAM, CAPTURE_TIMEOUT);
+/** Capture, FIFO and streaming histograms; served on `/diagnostics`. */
+CameraStats cameraStats;
+/** Time (µs) from reading a `/ws` pump command to the relay being set. */
+const uint32_t WS_COMMAND_US_BOUNDS[] = {250, 500, 1000, 2000, 5000, 10000, 20000, 50000};
+Histogram<8> wsCommandUs{WS_COMMAND_US_BOUNDS};
+
+/**
+ * Captures whose JPEG size is within SCENE_CHANGE_PERMILLE of the last
+ * changed frame keep the cached ETag, so dashboard polls get
+ * `304 Not Modified` and `/stream` viewers are not sent the frame again.
+ * A changed frame is still published at least every SCENE_MAX_UNCHANGED ms.
+ */
+const uint16_t SCENE_CHANGE_PERMILLE = 20;
+const unsigned long SCENE_MAX_UNCHANGED = 60000;
+SceneChangeDetector sceneDetector(SCENE_CHANGE_PERMILLE, SCENE_MAX_UNCHANGED);
+
+/**
+ * Canopy cover is measured every CANOPY_INTERVAL from an RGB565 frame
+ * (canopy_analyser.h) and reported on `/sensor`, whether or not anybody is
+ * viewing images. The measurement overwrites the FIFO, so the next `/image`
+ * request captures a fresh frame.
+ */
+const unsigned long CANOPY_INTERVAL = 5UL * 60000;
+CanopyProbe canopyProbe(myCAM, camera);
+unsigned long lastCanopyAt = 0;
+
+/**
+ * Capture state machine, advanced by `cameraTick()` in small steps so the
+ * control loop never waits on the camera:
+ *   IDLE -> TRIGGERED -> DONE -> FRAMING -> CLEANUP -> IDLE  (background capture)
+ *   IDLE -> STREAMING -> CLEANUP -> IDLE                        (serving the cached frame)
+ *   IDLE -> CANOPY -> IDLE                                      (canopy measurement)
+ */
+enum CaptureState
+{
+    CAP_IDLE,      ///< FIFO holds the cached frame (if valid); a capture may be triggered
+    CAP_TRIGGERED, ///< Sensor is writing a frame into the FIFO
+    CAP_DONE,      ///< Capture finished or timed out; length not yet validated
+    CAP_FRAMING,   ///< FIFO is being scanned for the JPEG SOI/EOI, a slice per tick
+    CAP_STREAMING, ///< FIFO is being read out to a client
+    CAP_CLEANUP,   ///< Clear the capture flag before returning to idle
+    CAP_CANOPY     ///< Owned by canopyProbe: RGB565 capture and analysis, a slice per tick
+};
+CaptureState captureState = CAP_IDLE;
+unsigned long lastImageRequest = 0;
+bool imageRequested = false;
+
+/** === MJPEG stream server === */
+/**
+ * `/stream` is served on its own port (as the ESP32-CAM web server does)
+ * because a stream never ends and the HTTP server serves its connections
+ * one request at a time. Stream clients are kept in a small table and fed from the frame
+ * cache by `streamTick()`; one capture is shared by every viewer.
+ */
+#define STREAM_PORT 81
+#define STREAM_BOUNDARY "agriframe"
+const uint8_t STREAM_MAX_CLIENTS = 2;
+const uint8_t STREAM_MAX_FPS = 2;
+const unsigned long STREAM_FRAME_INTERVAL = 1000 / STREAM_MAX_FPS;
+WiFiServer streamServer(STREAM_PORT);
+struct StreamClient
+{
+    WiFiClient client;
+    bool active;
+    uint32_t lastSeq;         ///< Sequence number of the last frame sent
+    unsigned long lastSentAt; ///< millis() of the last frame sent (fps cap)
+};
+StreamClient streamClients[STREAM_MAX_CLIENTS];
+uint8_t streamClientCount = 0;
+
+/** === Control loop instrumentation === */
+/**
+ * Worst-case gap between consecutive `controlTick()` calls, split by whether
+ * the camera was busy during the gap. Reported on `/status`.
+ */
+unsigned long lastControlTick = 0;
+unsigned long stallMaxIdleMs = 0;
+unsigned long stallMaxCaptureMs = 0;
+/** Set whenever the camera state machine is busy; cleared by each control tick. */
+bool cameraBusySinceTick = false;
+
+/**
+ * @brief Read sensors, drive the pump and refresh the LCD when due (defined below).
+ */
+void controlTick();
+
+/**
+ * @brief Apply the pump mode to the current level and drive the relay (defined below).
+ */
+void updatePump();
 
 /** === Time helpers (epoch to date conversion without RTClib) === */
 /** Converts epoch seconds to year, month, day, hour, minute, second. */
@@ -174,7 +339,248 @@ unsigned long ukLocalEpoch(unsigned long utcEpoch)
 }
 
 /**
- * --- Route handlers for UnoR4WiFi_WebServer ------------------------------
+ * @brief Trigger a capture into the FIFO without waiting for it.
+ *
+ * The FIFO is overwritten, so the cached frame is invalidated until the
+ * state machine reaches CAP_DONE and validates the new frame.
+ */
+void cameraTrigger()
+{
+    frameCache.valid = false;
+    camera.trigger();
+    captureState = CAP_TRIGGERED;
+    cameraBusySinceTick = true;
+}
+
+/**
+ * @brief Advance the capture state machine by one step. Never blocks.
+ *
+ * In CAP_IDLE this is also the frame cache scheduler: it keeps a frame no
+ * older than FRAME_REFRESH_INTERVAL while somebody has asked for `/image`
+ * recently, captures back-to-back (capped at STREAM_MAX_FPS) while `/stream`
+ * clients are connected, and goes quiet otherwise.
+ */
+void cameraTick()
+{
+    if (captureState != CAP_IDLE)
+        cameraBusySinceTick = true;
+
+    switch (captureState)
+    {
+    case CAP_IDLE:
+    {
+        // Health checks and recovery touch the camera, so only run them between captures.
+        if (cameraHealth.tick())
+        {
+            Serial.println("camera: recovered");
+            myCAM.OV2640_set_JPEG_size(resolution.current().size);
+            resolution.applied(millis());
+            sceneDetector.reset();
+        }
+        if (cameraEnabled && !cameraHealth.ok())
+        {
+            Serial.println("camera: not responding, recovering");
+            frameCache.valid = false;
+        }
+        cameraEnabled = cameraHealth.ok();
+        if (!cameraEnabled)
+            return;
+        unsigned long now = millis();
+        if (lastCanopyAt == 0 || now - lastCanopyAt >= CANOPY_INTERVAL)
+        {
+            lastCanopyAt = now;
+            frameCache.valid = false;
+            canopyProbe.start(resolution.current().size);
+            captureState = CAP_CANOPY;
+            return;
+        }
+        bool streaming = streamClientCount > 0;
+        // An open `/events` or `/ws` connection is a dashboard showing the preview.
+        bool watched = events.count() > 0 || ws.count() > 0;
+        if (!streaming && !watched && (!imageRequested || now - lastImageRequest > FRAME_VIEWER_TIMEOUT))
+            return;
+#if ADAPTIVE_RESOLUTION
+        // Resize between frames only. The cached frame stays valid, and no
+        // capture starts until the sensor has settled at the new size.
+        if (resolution.update(now))
+        {
+            myCAM.OV2640_set_JPEG_size(resolution.current().size);
+            resolution.applied(millis());
+            sceneDetector.reset();
+        }
+        if (resolution.settling(now))
+            return;
+#endif
+        unsigned long interval = streaming ? STREAM_FRAME_INTERVAL : FRAME_REFRESH_INTERVAL;
+        if (!frameCache.valid || now - frameCache.capturedAt >= interval)
+            cameraTrigger();
+        break;
+    }
+    case CAP_TRIGGERED:
+        if (camera.ready())
+            captureState = CAP_DONE;
+        break;
+    case CAP_DONE:
+        lastCaptureResult = camera.finish();
+        cameraStats.recordCapture(camera.doneAt() - camera.startedAt(), camera.fifoLength(), camera.timedOut());
+        // Timeouts read as empty; several in a row mean the camera needs recovering.
+        cameraHealth.recordCapture(lastCaptureResult != CAPTURE_EMPTY);
+        if (lastCaptureResult == CAPTURE_OK)
+        {
+            // Scan the FIFO for the JPEG before publishing it. The burst
+            // stays open across ticks; nothing else uses SPI meanwhile.
+            camera.beginFraming();
+            captureState = CAP_FRAMING;
+        }
+        else
+        {
+            if (lastCaptureResult == CAPTURE_TOO_LARGE)
+                Serial.println("capture: frame too large, discarding");
+            captureState = CAP_CLEANUP;
+        }
+        break;
+    case CAP_FRAMING:
+        if (!camera.frameStep(FRAMING_SLICE))
+            break;
+        lastCaptureResult = camera.result();
+        if (lastCaptureResult == CAPTURE_OK)
+        {
+            frameCache.valid = true;
+            // An unchanged scene keeps the ETag; the FIFO now holds the newer, equivalent frame.
+            if (sceneDetector.changed(camera.length(), camera.doneAt()))
+                frameCache.seq++;
+            frameCache.offset = camera.start();
+            frameCache.length = camera.length();
+            frameCache.capturedAt = camera.doneAt();
+            frameCache.capturedEpoch = timeClient.getEpochTime();
+            resolution.recordCapture(frameCache.length, camera.doneAt() - camera.startedAt());
+        }
+        else
+        {
+            Serial.println("capture: invalid or truncated JPEG, dropping");
+        }
+        captureState = CAP_CLEANUP;
+        break;
+    case CAP_STREAMING:
+        // Owned by the handler streaming the frame; it moves on to CAP_CLEANUP.
+        break;
+    case CAP_CLEANUP:
+        camera.release();
+        captureState = CAP_IDLE;
+        break;
+    case CAP_CANOPY:
+        // The probe restores JPEG mode and releases the FIFO before it goes idle.
+        canopyProbe.tick(FRAMING_SLICE);
+        if (!canopyProbe.busy())
+            captureState = CAP_IDLE;
+        break;
+    }
+}
+
+/**
+ * @brief Look up a query parameter by name. Returns an empty string when absent.
+ */
+String queryParam(const QueryParams &params, const char *name)
+{
+    for (int i = 0; i < params.count; ++i)
+    {
+        if (params.params[i].key == name)
+            return params.params[i].value;
+    }
+    return String("");
+}
+
+/**
+ * @brief Look up a request header (case-insensitive) in the raw request text.
+ *
+ * Returns an empty string when the header is absent or the server did not
+ * pass the request headers through.
+ */
+String requestHeader(const String &request, const char *name)
+{
+    String lower = request;
+    lower.toLowerCase();
+    String key = String("\n") + name + ":";
+    key.toLowerCase();
+    int at = lower.indexOf(key.c_str());
+    if (at < 0)
+        return String("");
+    int start = at + key.length();
+    int end = request.indexOf('\r', start);
+    if (end < 0)
+        end = request.indexOf('\n', start);
+    String value = (end < 0) ? request.substring(start) : request.substring(start, end);
+    value.trim();
+    return value;
+}
+
+/**
+ * @brief PrintSink for a client that services the control loop after each block.
+ *
+ * Each block is a time slice: sensors, relay and LCD sit on I2C/GPIO, so
+ * they can run while the FIFO burst stays open.
+ */
+class ClientFrameSink : public PrintSink
+{
+public:
+    ClientFrameSink(WiFiClient &client, bool chunked) : PrintSink(client, chunked), sent(0) {}
+
+    bool write(uint8_t *buf, size_t n) override
+    {
+        if (!PrintSink::write(buf, n))
+            return false;
+        sent += n;
+        controlTick();
+        return true;
+    }
+
+    uint32_t sent; ///< Payload bytes accepted by the client
+};
+
+/**
+ * @brief Stream the cached frame from the FIFO to a client.
+ *
+ * Reads exactly the JPEG found by the framer (no leading junk or trailing
+ * FIFO padding) through the camera pipeline, one SPI buffer transfer per
+ * block. The WiFi write is the slow side, so no extra delay is needed
+ * between blocks.
+ *
+ * With `chunked` set, each block is framed for `Transfer-Encoding: chunked`
+ * and the terminating zero-length chunk is sent at the end.
+ *
+ * The caller must have checked `frameCache.valid` with the camera idle.
+ * Returns false if the client stopped accepting data part-way.
+ */
+bool streamCachedFrame(WiFiClient &client, bool chunked)
+{
+    captureState = CAP_STREAMING;
+    cameraBusySinceTick = true;
+    ClientFrameSink sink(client, chunked);
+    unsigned long tStream = millis();
+    bool ok = camera.sendRange(sink, frameCache.offset, frameCache.length);
+    captureState = CAP_CLEANUP;
+    cameraTick();
+    unsigned long elapsed = millis() - tStream;
+    uint32_t sent = sink.sent;
+    cameraStats.recordStream(sent, elapsed, ok);
+    // Short transfers are dominated by per-write latency; skip them.
+    if (ok && sent >= 1024)
+        resolution.recordStream(sent, elapsed);
+#if CAM_LOG_THROUGHPUT
+    Serial.print("streamCachedFrame: streamed ");
+    Serial.print(sent);
+    Serial.print(" bytes in ");
+    Serial.print(elapsed);
+    Serial.print(" ms (");
+    // Bytes per ms is roughly KB/s; a frame sent within one tick counts as 1 ms.
+    Serial.print(sent / (elapsed ? elapsed : 1));
+    Serial.println(" KB/s)");
+#endif
+    return ok;
+}
+
+/**
+ * --- Route handlers for HttpServer ---------------------------------------
  * Handler signature:
  *   (WiFiClient& client, const String& method, const String& request,
  *    const QueryParams& params, const String& jsonData)
@@ -187,82 +593,171 @@ unsigned long ukLocalEpoch(unsigned long utcEpoch)
  */
 void handleRoot(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
 {
-    // INDEX_PAGE is a raw HTML string defined in `index_page.h`
-    server.sendResponse(client, INDEX_PAGE);
+    // INDEX_PAGE is a raw HTML string defined in `index_page.h`; too large
+    // for a response buffer, so the head goes first and the page follows.
+    size_t length = strlen(INDEX_PAGE);
+    char headers[32];
+    snprintf(headers, sizeof(headers), "Content-Length: %u\r\n", (unsigned)length);
+    HttpResponse<0> res;
+    res.sendHead(client, 200, "OK", "text/html; charset=utf-8", headers);
+    if (client.write((const uint8_t *)INDEX_PAGE, length) != length)
+        httpKeepAlive() = false;
+}
+
+/** Device status object served by `/status` and `/api/snapshot`. */
+void printStatusJson(Print &out)
+{
+    String ip = WiFi.localIP().toString();
+    bool connected = (WiFi.status() == WL_CONNECTED);
+    out.print("{\"connected\":");
+    out.print(connected ? "true" : "false");
+    out.print(",\"ip\":\"");
+    if (connected)
+        out.print(ip);
+    out.print("\",\"cameraDetected\":");
+    out.print(cameraDetectedAtInit ? "true" : "false");
+    out.print(",\"camera\":\"");
+    out.print(cameraHealth.status());
+    out.print("\",\"cameraOutages\":");
+    out.print(cameraHealth.outages());
+    out.print(",\"cameraRecoveries\":");
+    out.print(cameraHealth.recoveries());
+    out.print(",\"resolution\":\"");
+    out.print(resolution.current().width);
+    out.print("x");
+    out.print(resolution.current().height);
+    out.print("\"");
+    out.print(",\"framesDropped\":");
+    out.print(camera.framer().dropped());
+    out.print(",\"framesUnchanged\":");
+    out.print(sceneDetector.unchanged());
+    out.print(",\"loopStallIdleMs\":");
+    out.print(stallMaxIdleMs);
+    out.print(",\"loopStallCaptureMs\":");
+    out.print(stallMaxCaptureMs);
+    out.print("}");
 }
 
 /**
  * @brief Return device status as JSON.
  *
- * JSON fields: `connected` (bool), `ip` (string), `cameraDetected` (bool).
+ * JSON fields: `connected` (bool), `ip` (string), `cameraDetected` (bool, at boot),
+ * `camera` ("ok", "recovering" or "offline"), `cameraOutages` and
+ * `cameraRecoveries` (counts since boot), `resolution` (current JPEG size, e.g. "320x240"), `framesDropped` (captures
+ * discarded as invalid or truncated JPEG), `framesUnchanged` (captures that
+ * kept the previous ETag because the scene had not changed), and `loopStallIdleMs`
+ * and `loopStallCaptureMs` (worst-case control loop gap without and with a
+ * capture in progress).
  */
 void handleStatus(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
 {
-    String ip = WiFi.localIP().toString();
-    bool connected = (WiFi.status() == WL_CONNECTED);
-    client.println("HTTP/1.1 200 OK");
-    client.println("Content-Type: application/json");
-    client.println("Connection: close");
-    client.println();
-    client.print("{\"connected\":");
-    client.print(connected ? "true" : "false");
-    client.print(",\"ip\":\"");
-    if (connected)
-        client.print(ip);
-    client.print("\",\"cameraDetected\":");
-    client.print(cameraDetectedAtInit ? "true" : "false");
-    client.print("}");
+    HttpResponse<384> res;
+    printStatusJson(res);
+    res.send(client, 200, "OK", "application/json");
 }
 
 /**
- * @brief Return sensor readings as JSON.
+ * @brief Return camera pipeline histograms and counters as JSON.
  *
- * JSON fields: `temperature` (float), `humidity` (float), `level` (int, percent),
- * and `pump` (bool).
+ * JSON fields: `uptimeMs`, `camera` (see `CameraStats::printJson()`: capture
+ * time, FIFO length, stream time and throughput histograms, and timeout /
+ * 204 / 413 / 503 / aborted-stream counters) and `fifo` (`bytes` read from the
+ * FIFO, `spiMs` spent in SPI transfers and `totalMs` including the sinks) and
+ * `http` (`requests` served, `reused` connections and `open` connections)
+ * and `ws` (`commandUs`, pump command to relay time in microseconds).
+ * `?reset=1` clears the `camera`, `fifo` and `ws` figures after they are reported.
  */
-void handleSensor(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+void handleDiagnostics(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    HttpResponse<1536> res;
+    res.print("{\"uptimeMs\":");
+    res.print(millis());
+    res.print(",\"camera\":");
+    cameraStats.printJson(res);
+    res.print(",\"fifo\":");
+    camera.stats().printJson(res);
+    res.print(",\"http\":{\"requests\":");
+    res.print(server.requests());
+    res.print(",\"reused\":");
+    res.print(server.reused());
+    res.print(",\"open\":");
+    res.print(server.openConnections());
+    res.print("},\"ws\":{\"commandUs\":");
+    wsCommandUs.printJson(res);
+    res.print("}}");
+    res.send(client, 200, "OK", "application/json", "Cache-Control: no-store\r\n");
+    if (queryParam(params, "reset") == "1")
+    {
+        cameraStats.reset();
+        camera.resetStats();
+        wsCommandUs.reset();
+    }
+}
+
+/** Sensor reading and pump fields, shared by `/sensor` and the `sensor` event. */
+void printReadingsFields(Print &out)
 {
-    client.println("HTTP/1.1 200 OK");
-    client.println("Content-Type: application/json");
-    client.println("Connection: close");
-    client.println();
-    client.print("{\"temperature\":");
+    out.print("\"temperature\":");
     if (!isnan(lastTemp))
-        client.print(lastTemp, 1);
+        out.print(lastTemp, 1);
     else
-        client.print("null");
-    client.print(",\"humidity\":");
+        out.print("null");
+    out.print(",\"humidity\":");
     if (!isnan(lastHum))
-        client.print(lastHum, 0);
+        out.print(lastHum, 0);
     else
-        client.print("null");
-    client.print(",\"level\":");
+        out.print("null");
+    out.print(",\"level\":");
     if (lastLevel >= 0)
-        client.print(lastLevel);
+        out.print(lastLevel);
     else
-        client.print("null");
-    client.print(",\"pump\":");
-    if (lastLevel >= 0)
-        client.print(lastPumpOn ? "true" : "false");
+        out.print("null");
+    out.print(",\"pump\":");
+    if (lastLevel >= 0 || pumpMode != MODE_AUTO)
+        out.print(lastPumpOn ? "true" : "false");
     else
-        client.print("null");
+        out.print("null");
+    out.print(",\"mode\":\"");
+    out.print(pumpModeName(pumpMode));
+    out.print("\"");
 
     // Add a warning field for dashboard when temperature exceeds 30°C
-    client.print(",\"warning\":");
+    out.print(",\"warning\":");
     if (!isnan(lastTemp) && lastTemp > 30.0)
-        client.print("\"High temperature (>30°C)\"");
+        out.print("\"High temperature (>30°C)\"");
     else
-        client.print("null");
+        out.print("null");
+}
 
-    client.print("}");
+/** Sensor readings object served by `/sensor` and `/api/snapshot`. */
+void printSensorJson(Print &out)
+{
+    out.print("{");
+    printReadingsFields(out);
+    char canopy[160];
+    canopyFormatJson(canopy, sizeof(canopy), canopyProbe.result(), millis());
+    out.print(",\"canopy\":");
+    out.print(canopy);
+
+    out.print("}");
 }
 
 /**
- * @brief Return a formatted local datetime as JSON.
+ * @brief Return sensor readings as JSON.
  *
- * Uses the NTP client; the returned JSON contains a `datetime` string.
+ * JSON fields: `temperature` (float), `humidity` (float), `level` (int, percent),
+ * `pump` (bool), `warning` (string or null) and `canopy` (latest canopy
+ * measurement, see `canopyFormatJson()`, or null).
  */
-void handleTime(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+void handleSensor(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    HttpResponse<320> res;
+    printSensorJson(res);
+    res.send(client, 200, "OK", "application/json");
+}
+
+/** Local date and time object served by `/time` and `/api/snapshot`. */
+void printTimeJson(Print &out)
 {
     timeClient.update();
     unsigned long nowEpoch = timeClient.getEpochTime();
@@ -271,111 +766,606 @@ void handleTime(WiFiClient &client, const String &method, const String &request,
     char buf[32];
     snprintf(buf, sizeof(buf), "%02u/%02u/%04u %02u:%02u",
              localDT.day, localDT.month, localDT.year, localDT.hour, localDT.minute);
+    out.print("{\"datetime\":\"");
+    out.print(buf);
+    out.print("\"}");
+}
 
-    client.println("HTTP/1.1 200 OK");
-    client.println("Content-Type: application/json");
-    client.println("Connection: close");
-    client.println();
-    client.print("{\"datetime\":\"");
-    client.print(buf);
-    client.print("\"}");
+/**
+ * @brief Return a formatted local datetime as JSON.
+ *
+ * Uses the NTP client; the returned JSON contains a `datetime` string.
+ */
+void handleTime(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    HttpResponse<48> res;
+    printTimeJson(res);
+    res.send(client, 200, "OK", "application/json");
 }
 
 /**
- * @brief Capture a fresh JPEG frame and stream it to the client.
+ * @brief Cached frame metadata: `{ valid, seq, capturedAt, age }`, or `null`
+ * when the camera is disabled.
  *
- * This handler performs a blocking capture (with a short timeout) and then
- * streams the FIFO contents in small chunks to avoid ram errors.
+ * `seq` is the number in the `/image` ETag, so a client only needs to fetch
+ * `/image` when it changes. `capturedAt` is the NTP epoch of the capture (0 if
+ * unsynchronised) and `age` its age in seconds.
+ */
+void printFrameJson(Print &out)
+{
+    if (!cameraEnabled)
+    {
+        out.print("null");
+        return;
+    }
+    out.print("{\"valid\":");
+    out.print(frameCache.valid ? "true" : "false");
+    out.print(",\"seq\":");
+    out.print(frameCache.seq);
+    out.print(",\"capturedAt\":");
+    out.print(frameCache.capturedEpoch);
+    out.print(",\"age\":");
+    out.print((millis() - frameCache.capturedAt) / 1000);
+    out.print("}");
+}
+
+/**
+ * @brief Return status, sensor readings, time and frame metadata in one response.
+ *
+ * JSON fields: `status` (as `/status`), `sensor` (as `/sensor`), `time` (as
+ * `/time`) and `frame` (see `printFrameJson()`). The dashboard polls this
+ * instead of the three separate routes, so each refresh costs one connection
+ * and one Basic Auth check. Like `/image`, a poll keeps the frame cache
+ * refreshed in the background, so the dashboard can fetch `/image` only when
+ * `frame.seq` changes.
+ */
+void handleSnapshot(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    if (cameraEnabled)
+    {
+        lastImageRequest = millis();
+        imageRequested = true;
+    }
+    HttpResponse<896> res;
+    res.print("{\"status\":");
+    printStatusJson(res);
+    res.print(",\"sensor\":");
+    printSensorJson(res);
+    res.print(",\"time\":");
+    printTimeJson(res);
+    res.print(",\"frame\":");
+    printFrameJson(res);
+    res.print("}");
+    res.send(client, 200, "OK", "application/json");
+}
+
+/**
+ * @brief Answer 503 with `Retry-After: seconds` while the camera is briefly unavailable.
+ */
+void sendRetryLater(WiFiClient &client, const char *message, unsigned seconds)
+{
+    char retryAfter[24];
+    snprintf(retryAfter, sizeof(retryAfter), "Retry-After: %u\r\n", seconds);
+    cameraStats.unavailable++;
+    HttpResponse<40> res;
+    res.println(message);
+    res.send(client, 503, "Service Unavailable", "text/plain; charset=utf-8", retryAfter);
+}
+
+/**
+ * @brief Serve the cached JPEG frame, capturing one first if needed.
+ *
+ * The frame is streamed from the ArduCAM FIFO in CAM_BURST_CHUNK-sized SPI burst
+ * reads with chunked transfer encoding, so frames of any size up to the
+ * FIFO limit are served without buffering them in RAM. A fresh capture is only taken when the cache
+ * is empty or older than the optional `max-age` query parameter (seconds);
+ * `max-age=0` always captures. The response carries the frame sequence
+ * number as a weak ETag (`W/"<seq>"`, as frames of an unchanged scene keep
+ * it) so repeat viewers can revalidate cheaply.
  *
  * Responses:
- *  - 200 + image/jpeg when a valid JPEG is captured
- *  - 204 No Content when capture returns zero-length
- *  - 413 Payload Too Large when frame size exceeds MAX_STREAM_BYTES
- *  - 503 Service Unavailable when camera functionality is disabled
+ *  - 200 + image/jpeg when a valid JPEG is available
+ *  - 304 Not Modified when `If-None-Match` matches the cached frame
+ *  - 204 No Content when capture returns zero-length or an invalid/truncated JPEG
+ *  - 413 Payload Too Large when the frame overflowed the FIFO (MAX_FIFO)
+ *  - 503 Service Unavailable when camera functionality is disabled, or with
+ *    `Retry-After` when there is no cached frame while the sensor settles
+ *    after a resolution change or a canopy measurement holds the camera
  */
 void handleImage(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
 {
     if (!cameraEnabled)
     {
-        client.println("HTTP/1.1 503 Service Unavailable");
-        client.println("Content-Type: text/plain; charset=utf-8");
-        client.println("Connection: close");
-        client.println();
-        client.println("Camera disabled on device");
+        cameraStats.unavailable++;
+        HttpResponse<32> res;
+        res.println("Camera disabled on device");
+        res.send(client, 503, "Service Unavailable", "text/plain; charset=utf-8");
+        return;
+    }
+    lastImageRequest = millis();
+    imageRequested = true;
+    // A canopy measurement holds the camera in RGB565 mode for a few
+    // seconds and has overwritten the cached frame; come back after it.
+    if (captureState == CAP_CANOPY)
+    {
+        sendRetryLater(client, "Camera measuring canopy", 3);
         return;
     }
 
-    // Perform a fresh capture and stream the JPEG directly to the client
-    // using a small temporary buffer to avoid large RAM use.
-    // Start capture
-    myCAM.flush_fifo();
-    myCAM.clear_fifo_flag();
-    myCAM.start_capture();
+    // Capture when the cache cannot satisfy the request. An in-flight
+    // background capture has already invalidated the FIFO, so wait for it,
+    // servicing the control loop between polls so pump timing is kept.
+    String maxAge = queryParam(params, "max-age");
+    bool stale = maxAge.length() && (millis() - frameCache.capturedAt) > (unsigned long)maxAge.toInt() * 1000UL;
+    // While the sensor settles after a resize, a cached frame beats a forced one.
+    if (resolution.settling(millis()) && frameCache.valid)
+        stale = false;
+    if (captureState == CAP_IDLE && (!frameCache.valid || stale))
+    {
+        // No frame to fall back on while the sensor settles; the state
+        // machine captures once it has, so ask the client to come back.
+        if (resolution.settling(millis()))
+        {
+            sendRetryLater(client, "Camera changing resolution", 1);
+            return;
+        }
+        cameraTrigger();
+    }
+    while (captureState != CAP_IDLE)
+    {
+        cameraTick();
+        controlTick();
+    }
 
+    if (!frameCache.valid)
+    {
+        if (lastCaptureResult == CAPTURE_TOO_LARGE)
+        {
+            // If the frame is too large, return a 413 so the client can
+            // tell the difference between empty and oversized frames.
+            cameraStats.tooLarge++;
+            HttpResponse<32> res;
+            res.println("Captured image too large");
+            res.send(client, 413, "Payload Too Large", "text/plain; charset=utf-8");
+            return;
+        }
+        // Zero length, timeout or a dropped (invalid) JPEG: no frame to serve.
+        cameraStats.noContent++;
+        HttpResponse<0> res;
+        res.send(client, 204, "No Content");
+        return;
+    }
 
-    // Defining 2 second timeout for capture completion.
-    unsigned long t0 = millis();
-    while (!myCAM.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK))
+    // Weak ETag: frames of an unchanged scene share it without being byte-identical.
+    char etag[20];
+    snprintf(etag, sizeof(etag), "W/\"%lu\"", (unsigned long)frameCache.seq);
+    unsigned long age = (millis() - frameCache.capturedAt) / 1000;
+    char headers[128];
+    if (requestHeader(request, "If-None-Match") == etag)
     {
-        if (millis() - t0 > 2000)
-            break;
+        snprintf(headers, sizeof(headers), "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+        HttpResponse<0> res;
+        res.send(client, 304, "Not Modified", nullptr, headers);
+        return;
+    }
+
+    // The body is framed with chunked encoding by streamCachedFrame().
+    snprintf(headers, sizeof(headers),
+             "Transfer-Encoding: chunked\r\nETag: %s\r\nCache-Control: no-cache\r\nAge: %lu\r\n"
+             "X-Frame-Timestamp: %lu\r\n",
+             etag, age, frameCache.capturedEpoch);
+    HttpResponse<0> res;
+    res.sendHead(client, 200, "OK", "image/jpeg", headers);
+
+    // A stream cut short leaves the client waiting for the rest of the body.
+    if (!streamCachedFrame(client, true))
+        httpKeepAlive() = false;
+}
+
+/**
+ * --- MJPEG stream server (port STREAM_PORT) ------------------------------
+ */
+
+/**
+ * @brief Read the request head from a new stream-port client.
+ *
+ * Stores the request target in `path` and sets `authorised` when the
+ * `Authorization` header matches the configured Basic Auth credentials.
+ * The whole head must arrive within HTTP_HEADER_DEADLINE, so a slow client
+ * cannot hold up the loop (and the pump control with it); returns false if
+ * it did not.
+ */
+bool readStreamRequest(WiFiClient &client, String &path, bool &authorised)
+{
+    unsigned long deadline = millis() + HTTP_HEADER_DEADLINE;
+    String line;
+    if (!httpReadLine(client, line, deadline))
+        return false;
+    int sp1 = line.indexOf(' ');
+    int sp2 = (sp1 < 0) ? -1 : line.indexOf(' ', sp1 + 1);
+    path = (sp2 > sp1) ? line.substring(sp1 + 1, sp2) : String("");
+
+    authorised = false;
+    // Bound the header count as well as the time.
+    for (int i = 0; i < 32; ++i)
+    {
+        if (!httpReadLine(client, line, deadline))
+            return false;
+        if (line.length() == 0)
+            return true;
+        if (line.substring(0, 14).equalsIgnoreCase("Authorization:"))
+        {
+            String value = line.substring(14);
+            value.trim();
+            authorised = (value == server.authorization());
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Accept a new `/stream` client, or reject it with an error status.
+ */
+void streamAccept()
+{
+    WiFiClient client = streamServer.available();
+    if (!client)
+        return;
+    // Existing stream clients never need to send anything; discard it.
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        if (streamClients[i].active && streamClients[i].client == client)
+        {
+            while (client.available())
+                client.read();
+            return;
+        }
     }
 
-    // If length is zero, return 204 No Content as camera is not capturing frames.
-    uint32_t len = myCAM.read_fifo_length();
-    if (len == 0)
+    String path;
+    bool authorised;
+    if (!readStreamRequest(client, path, authorised))
+    {
+        HttpResponse<0> res;
+        res.send(client, 408, "Request Timeout");
+        client.stop();
+        return;
+    }
+    if (!authorised)
+    {
+        HttpResponse<0> res;
+        res.send(client, 401, "Unauthorized", nullptr, "WWW-Authenticate: Basic realm=\"Smart Agriculture\"\r\n");
+        client.stop();
+        return;
+    }
+    if (!path.startsWith("/stream"))
     {
-        myCAM.clear_fifo_flag();
-        client.println("HTTP/1.1 204 No Content");
-        client.println("Connection: close");
-        client.println();
+        HttpResponse<0> res;
+        res.send(client, 404, "Not Found");
+        client.stop();
         return;
     }
-    if (len >= MAX_STREAM_BYTES)
-    {
-        // If the frame is too large, log and return a 413 so
-        // the client can tell the difference between empty and oversized frames.
-        myCAM.clear_fifo_flag();
-        Serial.println("handleImage: captured frame too large, rejecting");
-        client.println("HTTP/1.1 413 Payload Too Large");
-        client.println("Content-Type: text/plain; charset=utf-8");
-        client.println("Connection: close");
-        client.println();
-        client.println("Captured image too large");
+    int slot = -1;
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        if (!streamClients[i].active)
+        {
+            slot = i;
+            break;
+        }
+    }
+    if (!cameraEnabled || slot < 0)
+    {
+        HttpResponse<32> res;
+        res.println(cameraEnabled ? "Too many stream clients" : "Camera disabled on device");
+        res.send(client, 503, "Service Unavailable", "text/plain; charset=utf-8");
+        client.stop();
         return;
     }
 
-    // Send headers with calculated content length.
-    client.println("HTTP/1.1 200 OK");
-    client.println("Content-Type: image/jpeg");
-    client.print("Content-Length: ");
-    client.println(len);
-    client.println("Connection: close");
-    client.println();
-
-    // Stream the FIFO directly in small chunks
-    myCAM.CS_LOW();
-    myCAM.set_fifo_burst();
-    const size_t BUF_SZ = CAM_CHUNK; // small stack buffer
-    uint8_t buf[BUF_SZ];
-    uint32_t remaining = len;
-    uint32_t streamed = 0;
-    // Read and send in chunks
-    while (remaining)
-    {
-        size_t toRead = (remaining > BUF_SZ) ? BUF_SZ : remaining;
-        for (size_t i = 0; i < toRead; ++i)
+    HttpResponse<0> res;
+    res.sendHead(client, 200, "OK", "multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY, "Cache-Control: no-cache\r\n");
+    streamClients[slot].client = client;
+    streamClients[slot].active = true;
+    streamClients[slot].lastSeq = 0;
+    streamClients[slot].lastSentAt = 0;
+    streamClientCount++;
+}
+
+/**
+ * @brief Drop a stream client and free its slot.
+ */
+void streamDrop(StreamClient &sc)
+{
+    sc.client.stop();
+    sc.active = false;
+    streamClientCount--;
+}
+
+/**
+ * @brief Service the stream port: accept clients and send each new cached frame.
+ *
+ * Called from `loop()`. A frame is sent to a client once, as a multipart
+ * part, and no more often than STREAM_MAX_FPS.
+ */
+void streamTick()
+{
+    streamAccept();
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < STREAM_MAX_CLIENTS; ++i)
+    {
+        StreamClient &sc = streamClients[i];
+        if (!sc.active)
+            continue;
+        if (!sc.client.connected())
+        {
+            streamDrop(sc);
+            continue;
+        }
+        if (captureState != CAP_IDLE || !frameCache.valid || frameCache.seq == sc.lastSeq)
+            continue;
+        if (sc.lastSentAt != 0 && now - sc.lastSentAt < STREAM_FRAME_INTERVAL)
+            continue;
+
+        // Part header in one write; the trailing CRLF goes with the next part.
+        char part[80];
+        int n = snprintf(part, sizeof(part), "%s--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %lu\r\n\r\n",
+                         sc.lastSentAt ? "\r\n" : "", (unsigned long)frameCache.length);
+        sc.client.write((const uint8_t *)part, n);
+        if (!streamCachedFrame(sc.client, false))
         {
-            buf[i] = SPI.transfer(0x00);
+            streamDrop(sc);
+            continue;
         }
-        client.write(buf, toRead);
-        remaining -= toRead;
-        streamed += toRead;
-        // Small delay to yield to other tasks and the client
-        delayMicroseconds(50);
+        sc.lastSeq = frameCache.seq;
+        sc.lastSentAt = now;
+    }
+}
+
+/**
+ * --- Event stream (`/events`) --------------------------------------------
+ */
+
+/** Values last pushed as a `sensor` event (temperature in tenths, as displayed). */
+struct PublishedReadings
+{
+    bool valid;
+    long tempTenths;
+    long hum;
+    int level;
+    bool pump;
+    PumpMode mode;
+};
+PublishedReadings publishedReadings = {false, 0, 0, 0, false, MODE_AUTO};
+uint32_t publishedFrameSeq = 0;
+long publishedMinute = -1;
+
+/**
+ * @brief Open a Server-Sent Events stream for the dashboard.
+ *
+ * Events (`data` is one line of JSON):
+ *  - `sensor`: `{ temperature, humidity, level, pump, mode, warning }` when a
+ *    reading (at display resolution), the pump state or its mode changes
+ *  - `frame`: frame metadata as in `/api/snapshot`, when a new frame is cached
+ *  - `time`: `{ datetime }` when the minute changes
+ * Idle connections get a comment every EVENTS_HEARTBEAT_MS. At most
+ * EVENTS_MAX_CLIENTS streams are open; further requests get 503.
+ */
+void handleEvents(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    if (events.count() >= EVENTS_MAX_CLIENTS)
+    {
+        httpKeepAlive() = false;
+        HttpResponse<32> res;
+        res.println("Too many event clients");
+        res.send(client, 503, "Service Unavailable", "text/plain; charset=utf-8");
+        return;
     }
-    myCAM.CS_HIGH();
-    myCAM.clear_fifo_flag();
+    HttpResponse<0> res;
+    res.sendHead(client, 200, "OK", "text/event-stream", "Cache-Control: no-cache\r\n");
+    if (events.add(client))
+        server.detach();
+    else
+        httpKeepAlive() = false;
+}
+
+/**
+ * @brief Push the events whose values changed since they were last sent.
+ *
+ * Called from `loop()`, outside any capture or stream, so the writes never
+ * interleave with a response.
+ */
+void eventsTick()
+{
+    if (events.count() == 0)
+    {
+        // The next client gets everything afresh.
+        publishedReadings.valid = false;
+        publishedFrameSeq = 0;
+        publishedMinute = -1;
+        return;
+    }
+
+    // A failed DHT read (NaN) maps to an impossible value so it still counts as a change.
+    PublishedReadings now = {true, isnan(lastTemp) ? -9999 : lroundf(lastTemp * 10),
+                             isnan(lastHum) ? -1 : lroundf(lastHum), lastLevel, lastPumpOn, pumpMode};
+    if (!publishedReadings.valid || now.tempTenths != publishedReadings.tempTenths ||
+        now.hum != publishedReadings.hum || now.level != publishedReadings.level || now.pump != publishedReadings.pump ||
+        now.mode != publishedReadings.mode)
+    {
+        events.begin("sensor");
+        events.print("{");
+        printReadingsFields(events);
+        events.print("}");
+        events.end();
+        publishedReadings = now;
+    }
+
+    if (cameraEnabled && frameCache.valid && frameCache.seq != publishedFrameSeq)
+    {
+        events.begin("frame");
+        printFrameJson(events);
+        events.end();
+        publishedFrameSeq = frameCache.seq;
+    }
+
+    long minute = (long)(timeClient.getEpochTime() / 60);
+    if (minute != publishedMinute)
+    {
+        events.begin("time");
+        printTimeJson(events);
+        events.end();
+        publishedMinute = minute;
+    }
+
+    events.tick();
+}
+
+/**
+ * --- WebSocket (`/ws`) ----------------------------------------------------
+ */
+
+/**
+ * Telemetry frame sent to `/ws` clients as one binary message (12 bytes,
+ * little-endian):
+ *   0  type      1
+ *   1  flags     bit0 pump on, bit1 temperature valid, bit2 humidity valid,
+ *                bit3 level valid, bit4 high-temperature warning
+ *   2  mode      0 auto, 1 forced on, 2 forced off
+ *   3  humidity  percent
+ *   4  temp      int16, tenths of °C
+ *   6  level     percent
+ *   7  reserved  0
+ *   8  frameSeq  uint32, sequence number of the cached frame (0 = none)
+ */
+const uint8_t WS_TELEMETRY = 1;
+const size_t WS_TELEMETRY_SIZE = 12;
+uint8_t wsPublished[WS_TELEMETRY_SIZE];
+bool wsPublishedValid = false;
+
+void buildTelemetryFrame(uint8_t *frame)
+{
+    bool tempValid = !isnan(lastTemp);
+    bool humValid = !isnan(lastHum);
+    int16_t temp = tempValid ? (int16_t)lroundf(lastTemp * 10) : 0;
+    uint32_t seq = (cameraEnabled && frameCache.valid) ? frameCache.seq : 0;
+    frame[0] = WS_TELEMETRY;
+    frame[1] = (lastPumpOn ? 0x01 : 0) | (tempValid ? 0x02 : 0) | (humValid ? 0x04 : 0) |
+               (lastLevel >= 0 ? 0x08 : 0) | ((tempValid && lastTemp > 30.0) ? 0x10 : 0);
+    frame[2] = (uint8_t)pumpMode;
+    frame[3] = humValid ? (uint8_t)lroundf(lastHum) : 0;
+    frame[4] = (uint8_t)temp;
+    frame[5] = (uint8_t)(temp >> 8);
+    frame[6] = lastLevel >= 0 ? (uint8_t)lastLevel : 0;
+    frame[7] = 0;
+    for (int i = 0; i < 4; ++i)
+        frame[8 + i] = (uint8_t)(seq >> (8 * i));
+}
+
+/** Broadcast the telemetry frame to `/ws` clients when it changed. */
+void wsTick()
+{
+    if (ws.count() == 0)
+    {
+        wsPublishedValid = false;
+        return;
+    }
+    uint8_t frame[WS_TELEMETRY_SIZE];
+    buildTelemetryFrame(frame);
+    if (!wsPublishedValid || memcmp(frame, wsPublished, sizeof(frame)) != 0)
+    {
+        ws.broadcast(frame, sizeof(frame));
+        memcpy(wsPublished, frame, sizeof(frame));
+        wsPublishedValid = true;
+    }
+    ws.tick();
+}
+
+/**
+ * @brief Upgrade the request to a WebSocket.
+ *
+ * After the handshake the client receives a telemetry frame whenever its
+ * contents change and may send the text commands `auto`, `on` and `off`.
+ * A `Sec-WebSocket-Version` other than 13 gets 426, and an `Origin` other
+ * than the dashboard's own gets 403. At most WS_MAX_CLIENTS sockets are
+ * open; further requests get 503.
+ */
+void handleWs(WiFiClient &client, const String &method, const String &request, const QueryParams &params, const String &jsonData)
+{
+    String key = requestHeader(request, "Sec-WebSocket-Key");
+    if (method != "GET" || !requestHeader(request, "Upgrade").equalsIgnoreCase("websocket") || key.length() == 0)
+    {
+        HttpResponse<48> res;
+        res.println("Expected a WebSocket upgrade");
+        res.send(client, 400, "Bad Request", "text/plain; charset=utf-8");
+        return;
+    }
+    if (requestHeader(request, "Sec-WebSocket-Version") != "13")
+    {
+        HttpResponse<40> res;
+        res.println("WebSocket version 13 required");
+        res.send(client, 426, "Upgrade Required", "text/plain; charset=utf-8", "Sec-WebSocket-Version: 13\r\n");
+        return;
+    }
+    if (!wsOriginAllowed(requestHeader(request, "Origin"), requestHeader(request, "Host")))
+    {
+        HttpResponse<40> res;
+        res.println("Cross-origin WebSocket refused");
+        res.send(client, 403, "Forbidden", "text/plain; charset=utf-8");
+        return;
+    }
+    if (ws.count() >= WS_MAX_CLIENTS)
+    {
+        httpKeepAlive() = false;
+        HttpResponse<32> res;
+        res.println("Too many WebSocket clients");
+        res.send(client, 503, "Service Unavailable", "text/plain; charset=utf-8");
+        return;
+    }
+    if (ws.accept(client, key))
+    {
+        server.detach();
+        // The new client gets the current state with the next `wsTick()`.
+        wsPublishedValid = false;
+    }
+    else
+    {
+        httpKeepAlive() = false;
+    }
+}
+
+/**
+ * @brief Apply a pump command from a `/ws` client.
+ *
+ * The relay is switched here rather than at the next control tick, and the
+ * new state goes back to every client at once. The time from reading the
+ * frame to setting the relay goes into `wsCommandUs` (`/diagnostics`).
+ */
+void handlePumpCommand(WiFiClient &client, const char *text, size_t n)
+{
+    PumpMode mode;
+    if (!pumpModeParse(text, n, mode))
+    {
+        ws.sendText(client, "unknown command");
+        return;
+    }
+    pumpMode = mode;
+    updatePump();
+    wsCommandUs.record(micros() - ws.receivedAt());
+    Serial.print("Pump mode: ");
+    Serial.println(pumpModeName(pumpMode));
+    wsTick();
+}
+
+/**
+ * @brief Take data on sockets the HTTP server has handed over.
+ *
+ * WebSocket frames are read and dispatched; anything an `/events` client
+ * sends is discarded.
+ */
+bool claimSocket(WiFiClient &client)
+{
+    return ws.service(client) || events.drain(client);
 }
 
 /**
@@ -424,21 +1414,27 @@ void setup()
     }
 
     // Perform camera initialisation when a module responded to the SPI test.
-    // Initialise the sensor and set camera resolution to 320x240 JPEG.
+    // Initialise the sensor in JPEG mode at the controller's starting size.
     if (cameraDetectedAtInit)
     {
         myCAM.set_format(JPEG);
         myCAM.InitCAM();
-        // Default to a small preview size for periodic dashboard captures
-        myCAM.OV2640_set_JPEG_size(OV2640_320x240);
+        // Start at a small preview size; the adaptive controller moves it from there.
+        myCAM.OV2640_set_JPEG_size(resolution.current().size);
         // Enable camera functionality when initialisation succeeds.
         cameraEnabled = true;
-        Serial.println("ArduCAM initialised (JPEG 320x240)");
+        Serial.print("ArduCAM initialised (JPEG ");
+        Serial.print(resolution.current().width);
+        Serial.print("x");
+        Serial.print(resolution.current().height);
+        Serial.println(")");
     }
     else
     {
         Serial.println("Camera not present, skipping initialisation");
     }
+    // A missing camera is probed again in the background and brought up if it appears.
+    cameraHealth.begin(cameraDetectedAtInit);
 
     // Initialise DHT sensor.
     dht.begin();
@@ -451,23 +1447,41 @@ void setup()
     else
         digitalWrite(RELAY_PIN, HIGH);
 
-    // Configure routes and start the UnoR4WiFi_WebServer which will handle
-    // the WiFi connection and incoming HTTP clients.
+    // Join the WiFi network; nothing below works without it, so keep trying.
+    Serial.print("Connecting to ");
+    Serial.println(ssid);
+    while (WiFi.begin(ssid, password) != WL_CONNECTED)
+    {
+        Serial.println("WiFi connection failed, retrying");
+        delay(2000);
+    }
+
+    // Configure routes and start the HTTP server.
     server.addRoute("/", handleRoot);
     server.addRoute("/status", handleStatus);
     server.addRoute("/sensor", handleSensor);
     server.addRoute("/time", handleTime);
+    server.addRoute("/api/snapshot", handleSnapshot);
+    server.addRoute("/events", handleEvents);
+    server.addRoute("/ws", handleWs);
     server.addRoute("/image", handleImage);
+    server.addRoute("/diagnostics", handleDiagnostics);
+
+    // Frames from `/ws` clients and stray bytes on `/events` streams are not HTTP requests.
+    server.setClaimHandler(claimSocket);
+    ws.onText(handlePumpCommand);
 
     // Enable simple Basic Auth — credentials must be provided in `arduino_secrets.h`
     server.enableAuthentication(SECRET_BASIC_USER, SECRET_BASIC_PASS, "Smart Agriculture");
 
-    // Start the server and let it manage the WiFi connection.
-    server.begin(ssid, password);
+    server.begin();
     Serial.print("HTTP server started. Open http://");
     Serial.print(WiFi.localIP());
     Serial.println(" on your phone or computer.");
 
+    // The stream port checks the same Basic Auth credentials itself.
+    streamServer.begin();
+
     // Start NTP client and attempt initial sync.
     timeClient.begin();
     timeClient.update();
@@ -484,15 +1498,51 @@ void setup()
 }
 
 /**
- * @brief Main loop: update display, read sensors, control pump, and handle HTTP clients.
+ * @brief Decide the pump state for the current mode and level and drive the relay.
  *
- * Ensures sensor reads and LCD updates run at a controlled interval and hands
- * off HTTP processing to the UnoR4WiFi_WebServer.
+ * Called by `controlTick()` after each level reading, and straight away when
+ * a `/ws` command changes the mode so the relay follows within one loop pass.
  */
-void loop()
+void updatePump()
+{
+    // Publish the last pump state so the web endpoints can report it.
+    lastPumpOn = pumpDecide(pumpMode, lastLevel, lastPumpOn, SECRET_TARGET_LEVEL, PUMP_HYSTERESIS);
+
+    // Drive relay according to pump state (respect RELAY_ACTIVE_HIGH).
+    if (lastPumpOn == (RELAY_ACTIVE_HIGH != 0))
+        digitalWrite(RELAY_PIN, HIGH);
+    else
+        digitalWrite(RELAY_PIN, LOW);
+}
+
+/**
+ * @brief Control loop step: read sensors, control pump and update the display.
+ *
+ * Runs the sensor/pump/LCD update at a controlled interval. Called from
+ * `loop()` and between time slices of long camera work, so pump timing does
+ * not depend on how long a capture or a client takes. Also records the
+ * worst-case gap between calls for `/status`.
+ */
+void controlTick()
 {
-    // Update LCD with sensor data at a controlled interval.
     unsigned long now = millis();
+    if (lastControlTick != 0)
+    {
+        unsigned long gap = now - lastControlTick;
+        if (cameraBusySinceTick)
+        {
+            if (gap > stallMaxCaptureMs)
+                stallMaxCaptureMs = gap;
+        }
+        else if (gap > stallMaxIdleMs)
+        {
+            stallMaxIdleMs = gap;
+        }
+    }
+    lastControlTick = now;
+    cameraBusySinceTick = (captureState != CAP_IDLE);
+
+    // Update LCD with sensor data at a controlled interval.
     if (now - lastDisplay >= displayInterval)
     {
         lastDisplay = now;
@@ -513,40 +1563,8 @@ void loop()
             level = 100;
         lastLevel = level;
 
-        // Determine pump state by comparing level to target using hysteresis.
-        bool pumpOn = false;
-        if (lastLevel >= 0)
-        {
-            if (!lastPumpOn)
-            {
-                // currently off: turn on when level falls strictly below target
-                pumpOn = (lastLevel < SECRET_TARGET_LEVEL);
-            }
-            else
-            {
-                // currently on: stay on until level rises above target + hysteresis
-                pumpOn = (lastLevel <= (SECRET_TARGET_LEVEL + PUMP_HYSTERESIS));
-            }
-        }
-        // Publish the last pump state so the web endpoint can report it.
-        lastPumpOn = pumpOn;
-
-        // Drive relay according to pump state (respect RELAY_ACTIVE_HIGH).
-        if (pumpOn)
-        {
-            if (RELAY_ACTIVE_HIGH)
-                digitalWrite(RELAY_PIN, HIGH);
-            else
-                digitalWrite(RELAY_PIN, LOW);
-        }
-        else
-        {
-            if (RELAY_ACTIVE_HIGH)
-                digitalWrite(RELAY_PIN, LOW);
-            else
-                digitalWrite(RELAY_PIN, HIGH);
-        }
-
+        // Determine pump state from the mode and the new level.
+        updatePump();
 
         // Prepare and print two fixed-width (16 char) LCD lines now that pump state
         // is known.
@@ -560,7 +1578,7 @@ void loop()
         {
             snprintf(line1, sizeof(line1), "T:%4.1fC H:%3.0f%%", t, h);
         }
-        snprintf(line2, sizeof(line2), "Lvl:%3d%% P:%s", lastLevel >= 0 ? lastLevel : 0, pumpOn ? "On" : "Off");
+        snprintf(line2, sizeof(line2), "Lvl:%3d%% P:%s", lastLevel >= 0 ? lastLevel : 0, lastPumpOn ? "On" : "Off");
         for (size_t i = strlen(line1); i < 16; ++i)
             line1[i] = ' ';
         line1[16] = '\0';
@@ -574,8 +1592,35 @@ void loop()
         lcd.setCursor(0, 1);
         lcd.print(line2);
     }
+}
+
+/**
+ * @brief Main loop: read `/ws` commands, run the control step, advance the camera, and handle HTTP clients.
+ *
+ * Each step is short; the camera state machine keeps the cached frame fresh
+ * without blocking, and the HTTP server serves one pending request per pass.
+ * A pump command waits at most one pass before it is read.
+ */
+void loop()
+{
+    // Read pump commands first, so they never wait behind a stream slice or an HTTP request.
+    ws.poll();
+
+    controlTick();
+
+    // Keep the cached camera frame fresh while viewers are active.
+    cameraTick();
+
+    // Feed connected MJPEG stream clients.
+    streamTick();
+
+    // Push changed readings, frames and time to `/events` clients.
+    eventsTick();
+
+    // Push changed telemetry frames to `/ws` clients.
+    wsTick();
 
-    // Let the UnoR4WiFi_WebServer handle incoming HTTP requests and routing.
+    // Serve one HTTP request from whichever connection has one pending.
     server.handleClient();
     delay(1);
 }
@@ -0,0 +1,134 @@
+/**
+ * @file jpeg_framer.h
+ * @brief Locate the JPEG inside an ArduCAM FIFO read-out.
+ *
+ * The FIFO holds the JPEG with possible leading junk (a dummy byte on older
+ * ArduChip revisions) and trailing padding up to `read_fifo_length()`. The
+ * framer is fed the FIFO contents chunk by chunk, finds the SOI (0xFFD8)
+ * and EOI (0xFFD9) markers, even when a marker straddles two chunks, and
+ * reports the exact offset and length of the JPEG.
+ *
+ * Frames without an SOI near the start, or that end without an EOI, are
+ * counted as invalid so callers can drop them instead of serving them.
+ *
+ * Plain C++ with no Arduino dependencies, so it can also be built on a host.
+ *
+ * Usage:
+ *   framer.begin();
+ *   while (more data && !framer.done()) framer.feed(buf, n);
+ *   if (framer.end()) { send framer.length() bytes from framer.start() }
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class JpegFramer
+{
+public:
+    /** SOI must appear within this many bytes of the start of the FIFO. */
+    static const uint32_t SOI_SEARCH_LIMIT = 64;
+
+    /** Per-framer counters, cumulative across frames. */
+    struct Stats
+    {
+        uint32_t ok;        ///< Frames with SOI and EOI
+        uint32_t noSoi;     ///< No SOI within SOI_SEARCH_LIMIT bytes
+        uint32_t truncated; ///< SOI found but data ended before EOI
+    };
+
+    JpegFramer() : _stats{0, 0, 0} { begin(); }
+
+    /** Start framing a new FIFO read-out. */
+    void begin()
+    {
+        _state = SEEK_SOI;
+        _pos = 0;
+        _start = 0;
+        _end = 0;
+        _prev = 0;
+    }
+
+    /** Scan the next `n` bytes of the read-out. Bytes after `done()` are ignored. */
+    void feed(const uint8_t *buf, size_t n)
+    {
+        for (size_t i = 0; i < n && !done(); ++i, ++_pos)
+        {
+            uint8_t cur = buf[i];
+            if (_state == SEEK_SOI)
+            {
+                if (_prev == 0xFF && cur == 0xD8)
+                {
+                    _state = IN_FRAME;
+                    _start = _pos - 1;
+                }
+                else if (_pos >= SOI_SEARCH_LIMIT)
+                {
+                    _state = NO_SOI;
+                }
+            }
+            else if (_prev == 0xFF && cur == 0xD9)
+            {
+                _state = COMPLETE;
+                _end = _pos + 1;
+            }
+            _prev = cur;
+        }
+    }
+
+    /** True once the frame is complete or known to be invalid; no more data is needed. */
+    bool done() const { return _state == COMPLETE || _state == NO_SOI; }
+
+    /**
+     * @brief Finish the read-out and update the counters.
+     *
+     * Returns true when a complete JPEG (SOI..EOI) was found.
+     */
+    bool end()
+    {
+        switch (_state)
+        {
+        case COMPLETE:
+            _stats.ok++;
+            return true;
+        case IN_FRAME:
+            _state = TRUNCATED;
+            _stats.truncated++;
+            return false;
+        case SEEK_SOI:
+            _state = NO_SOI;
+            // fall through
+        default:
+            _stats.noSoi++;
+            return false;
+        }
+    }
+
+    /** True when the last frame was complete. */
+    bool valid() const { return _state == COMPLETE; }
+    /** Offset of the SOI marker from the start of the read-out. */
+    uint32_t start() const { return _start; }
+    /** Exact JPEG length, SOI to EOI inclusive (0 unless valid). */
+    uint32_t length() const { return valid() ? _end - _start : 0; }
+
+    const Stats &stats() const { return _stats; }
+    /** Frames dropped as invalid (no SOI or truncated). */
+    uint32_t dropped() const { return _stats.noSoi + _stats.truncated; }
+
+private:
+    enum State
+    {
+        SEEK_SOI,
+        IN_FRAME,
+        COMPLETE,
+        NO_SOI,
+        TRUNCATED
+    };
+
+    State _state;
+    uint32_t _pos;
+    uint32_t _start;
+    uint32_t _end;
+    uint8_t _prev;
+    Stats _stats;
+};
@@ -0,0 +1,68 @@
+/**
+ * @file pump_control.h
+ * @brief Pump modes and the level hysteresis, shared by both firmwares.
+ *
+ * In automatic mode the pump turns on when the water level falls strictly
+ * below the target and stays on until it rises above target + hysteresis,
+ * so it does not chatter around the threshold. An unknown level (negative)
+ * keeps the pump off. The forced modes ignore the level.
+ *
+ * Commands are the strings `auto`, `on` and `off`, whichever transport
+ * carries them (MQTT `<base>/pump/cmd`, the HTTP firmware's `/ws`).
+ *
+ * Plain C++, no Arduino dependencies.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+
+/** Pump may be controlled automatically based on level, or forced on/off by a command. */
+enum PumpMode
+{
+    MODE_AUTO,     ///< Automatic: use hysteresis logic based on water level
+    MODE_FORCE_ON, ///< Forced on by a command
+    MODE_FORCE_OFF ///< Forced off by a command
+};
+
+/** Command name of a mode: "auto", "on" or "off". */
+inline const char *pumpModeName(PumpMode mode)
+{
+    return (mode == MODE_AUTO) ? "auto" : (mode == MODE_FORCE_ON ? "on" : "off");
+}
+
+/** Parse a command of `n` bytes (not NUL-terminated). Returns false if it is not a mode. */
+inline bool pumpModeParse(const char *text, size_t n, PumpMode &mode)
+{
+    static const PumpMode MODES[] = {MODE_AUTO, MODE_FORCE_ON, MODE_FORCE_OFF};
+    for (PumpMode m : MODES)
+    {
+        const char *name = pumpModeName(m);
+        if (strlen(name) == n && memcmp(name, text, n) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Whether the pump should run.
+ *
+ * @param mode       Control mode
+ * @param level      Water level in percent, or negative when unknown
+ * @param on         Whether the pump is running now (for the hysteresis)
+ * @param target     Level below which automatic mode starts the pump
+ * @param hysteresis Percent above target at which automatic mode stops it
+ */
+inline bool pumpDecide(PumpMode mode, int level, bool on, int target, int hysteresis)
+{
+    if (mode == MODE_FORCE_ON)
+        return true;
+    if (mode == MODE_FORCE_OFF || level < 0)
+        return false;
+    // Currently off: turn on when level falls strictly below target.
+    // Currently on: stay on until level rises above target + hysteresis.
+    return on ? level <= target + hysteresis : level < target;
+}
@@ -0,0 +1,164 @@
+/**
+ * @file resolution_controller.h
+ * @brief Adaptive OV2640 JPEG resolution driven by measured frame latency.
+ *
+ * The controller keeps running averages of the frame size, capture time and
+ * streaming throughput at the current step of the OV2640 resolution ladder.
+ * From these it predicts the end-to-end latency (capture + transfer) of the
+ * current and next larger step, assuming JPEG size scales with pixel count,
+ * and moves one step at a time towards the largest resolution that meets
+ * the latency target and stays under the frame size bound.
+ *
+ * Thrashing is avoided by requiring several frames at a step before any
+ * decision, a minimum dwell time between changes, and a headroom margin
+ * before stepping up. After a change the sensor needs time to settle; the
+ * controller reports `settling()` for that period so the caller can hold
+ * off captures instead of blocking in `delay()`.
+ *
+ * The controller only decides; the sketch applies the change with
+ * `OV2640_set_JPEG_size()` and reports back through `applied()`.
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <ArduCAM.h>
+
+/** One rung of the OV2640 JPEG resolution ladder. */
+struct ResolutionStep
+{
+    uint8_t size; ///< OV2640_* size constant for OV2640_set_JPEG_size()
+    uint16_t width;
+    uint16_t height;
+};
+
+static const ResolutionStep RESOLUTION_LADDER[] = {
+    {OV2640_160x120, 160, 120},
+    {OV2640_176x144, 176, 144},
+    {OV2640_320x240, 320, 240},
+    {OV2640_352x288, 352, 288},
+    {OV2640_640x480, 640, 480},
+    {OV2640_800x600, 800, 600},
+    {OV2640_1024x768, 1024, 768},
+    {OV2640_1280x1024, 1280, 1024},
+    {OV2640_1600x1200, 1600, 1200},
+};
+static const uint8_t RESOLUTION_STEPS = sizeof(RESOLUTION_LADDER) / sizeof(RESOLUTION_LADDER[0]);
+
+class ResolutionController
+{
+public:
+    /** Frames required at a step before it is judged. */
+    static const uint8_t MIN_SAMPLES = 3;
+    /** Minimum time between two resolution changes (ms). */
+    static const unsigned long DWELL_MS = 20000;
+    /** Sensor settle time after a size change (ms); the ArduCAM example waits 1 s. */
+    static const unsigned long SETTLE_MS = 1000;
+
+    /**
+     * @param startStep     Initial index into RESOLUTION_LADDER
+     * @param maxStep       Largest index the controller may choose
+     * @param targetMs      Target capture + transfer latency per frame
+     * @param maxFrameBytes Frames predicted above this size are never chosen
+     */
+    ResolutionController(uint8_t startStep, uint8_t maxStep, unsigned long targetMs, uint32_t maxFrameBytes)
+        : _step(startStep), _maxStep(maxStep), _targetMs(targetMs), _maxFrameBytes(maxFrameBytes),
+          _frameBytes(0), _captureMs(0), _bytesPerMs(0), _samples(0), _changedAt(0), _settleUntil(0)
+    {
+    }
+
+    /** Record a completed capture at the current step. */
+    void recordCapture(uint32_t frameBytes, unsigned long captureMs)
+    {
+        _frameBytes = average(_frameBytes, frameBytes, _samples == 0);
+        _captureMs = average(_captureMs, captureMs, _samples == 0);
+        if (_samples < 255)
+            _samples++;
+    }
+
+    /** Record a completed transfer of `bytes` that took `elapsedMs`. */
+    void recordStream(uint32_t bytes, unsigned long elapsedMs)
+    {
+        if (elapsedMs == 0)
+            elapsedMs = 1;
+        _bytesPerMs = average(_bytesPerMs, (float)bytes / elapsedMs, _bytesPerMs == 0);
+    }
+
+    /**
+     * @brief Re-evaluate the resolution.
+     *
+     * Returns true when `step()` changed and the caller must apply it.
+     */
+    bool update(unsigned long now)
+    {
+        if (settling(now) || _samples < MIN_SAMPLES || _bytesPerMs <= 0)
+            return false;
+        if (_changedAt != 0 && now - _changedAt < DWELL_MS)
+            return false;
+
+        if (_step > 0 && (predictLatency(_step) > _targetMs || _frameBytes > _maxFrameBytes))
+        {
+            _step--;
+            return true;
+        }
+        // Step up only with clear headroom so the next step is not immediately undone.
+        if (_step < _maxStep && predictLatency(_step + 1) < _targetMs * 0.6f &&
+            predictBytes(_step + 1) < _maxFrameBytes)
+        {
+            _step++;
+            return true;
+        }
+        return false;
+    }
+
+    /** Tell the controller the current step has been written to the sensor. */
+    void applied(unsigned long now)
+    {
+        _changedAt = now;
+        _settleUntil = now + SETTLE_MS;
+        // Size and capture time are per-step; link throughput carries over.
+        _samples = 0;
+        _frameBytes = 0;
+        _captureMs = 0;
+    }
+
+    /** True while the sensor is still settling after a size change. */
+    bool settling(unsigned long now) const
+    {
+        return (long)(_settleUntil - now) > 0;
+    }
+
+    uint8_t step() const { return _step; }
+    const ResolutionStep &current() const { return RESOLUTION_LADDER[_step]; }
+
+private:
+    static float average(float avg, float sample, bool first)
+    {
+        return first ? sample : avg + (sample - avg) * 0.25f;
+    }
+
+    static float pixels(uint8_t step)
+    {
+        return (float)RESOLUTION_LADDER[step].width * RESOLUTION_LADDER[step].height;
+    }
+
+    float predictBytes(uint8_t step) const
+    {
+        return _frameBytes * pixels(step) / pixels(_step);
+    }
+
+    float predictLatency(uint8_t step) const
+    {
+        return _captureMs + predictBytes(step) / _bytesPerMs;
+    }
+
+    uint8_t _step;
+    uint8_t _maxStep;
+    unsigned long _targetMs;
+    uint32_t _maxFrameBytes;
+    float _frameBytes; ///< Average FIFO frame size at the current step
+    float _captureMs;  ///< Average trigger-to-done time at the current step
+    float _bytesPerMs; ///< Average streaming throughput (any step)
+    uint8_t _samples;
+    unsigned long _changedAt;
+    unsigned long _settleUntil;
+};
@@ -0,0 +1,69 @@
+/**
+ * @file scene_change.h
+ * @brief Cheap scene-change detection from the JPEG size.
+ *
+ * At a fixed resolution and quality the compressed size of a frame tracks
+ * the amount of detail in it, so a static scene produces frames whose sizes
+ * differ by well under a percent while a moved camera, a person or a change
+ * in light moves it by several. The size is known as soon as the framer
+ * has scanned the FIFO, so the check costs nothing extra.
+ *
+ * Each frame is compared with the last frame that was reported as changed,
+ * not with its predecessor, so slow drift accumulates until it crosses the
+ * threshold instead of being missed. A frame is always reported as changed
+ * once `maxUnchangedMs` has passed, so consumers still get periodic fresh
+ * frames.
+ *
+ * Plain C++, no Arduino dependencies.
+ */
+#pragma once
+
+#include <stdint.h>
+
+class SceneChangeDetector
+{
+public:
+    /**
+     * @param thresholdPermille Size change (in 1/1000 of the reference) that counts as a new scene
+     * @param maxUnchangedMs    Report a change at least this often (ms)
+     */
+    SceneChangeDetector(uint16_t thresholdPermille, unsigned long maxUnchangedMs)
+        : _threshold(thresholdPermille), _maxUnchangedMs(maxUnchangedMs), _reference(0), _referenceAt(0),
+          _unchanged(0)
+    {
+    }
+
+    /**
+     * @brief Judge a new frame of `length` bytes captured at `now` (ms).
+     *
+     * Returns true when the frame should be delivered; it then becomes the
+     * new reference. Returns false for a frame that can be suppressed.
+     */
+    bool changed(uint32_t length, unsigned long now)
+    {
+        uint32_t diff = (length > _reference) ? length - _reference : _reference - length;
+        bool isNew = _reference == 0 || now - _referenceAt >= _maxUnchangedMs ||
+                     (uint64_t)diff * 1000 > (uint64_t)_reference * _threshold;
+        if (!isNew)
+        {
+            _unchanged++;
+            return false;
+        }
+        _reference = length;
+        _referenceAt = now;
+        return true;
+    }
+
+    /** Forget the reference (e.g. after a resolution change) so the next frame is delivered. */
+    void reset() { _reference = 0; }
+
+    /** Frames suppressed as unchanged since boot. */
+    uint32_t unchanged() const { return _unchanged; }
+
+private:
+    uint16_t _threshold;
+    unsigned long _maxUnchangedMs;
+    uint32_t _reference;
+    unsigned long _referenceAt;
+    uint32_t _unchanged;
+};
@@ -0,0 +1,81 @@
+/**
+ * @file serial_frame.h
+ * @brief Binary framing for camera frames sent over Serial.
+ *
+ * Each frame is a fixed 20-byte header followed by the JPEG payload. All
+ * fields are little-endian:
+ *
+ *   offset  size  field
+ *   0       4     magic "AGF1"
+ *   4       4     sequence number (increments per frame sent)
+ *   8       4     timestamp, ms since device boot
+ *   12      4     payload length in bytes
+ *   16      4     CRC-32 of the payload (crc32.h)
+ *
+ * A receiver finds frames by the magic, knows exactly how many bytes to
+ * read, and verifies them with the CRC. After corruption it resumes the
+ * search one byte past the bad magic. Text lines printed by the sketches
+ * between frames are skipped the same way.
+ *
+ * Plain C++, shared with the host receiver in `tools/`.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+static const uint8_t SERIAL_FRAME_MAGIC[4] = {'A', 'G', 'F', '1'};
+static const size_t SERIAL_FRAME_HEADER_SIZE = 20;
+/** Largest payload a receiver accepts: the ArduCAM FIFO size. */
+static const uint32_t SERIAL_FRAME_MAX_PAYLOAD = 0x7FFFF;
+
+struct SerialFrameHeader
+{
+    uint32_t seq;
+    uint32_t timestamp;
+    uint32_t length;
+    uint32_t crc;
+};
+
+/** Write `v` little-endian into 4 bytes at `p`. */
+inline void serialFramePut32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+/** Read a little-endian 32-bit value from `p`. */
+inline uint32_t serialFrameGet32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/** Encode `h` into a SERIAL_FRAME_HEADER_SIZE-byte buffer. */
+inline void serialFrameEncode(uint8_t *out, const SerialFrameHeader &h)
+{
+    memcpy(out, SERIAL_FRAME_MAGIC, 4);
+    serialFramePut32(out + 4, h.seq);
+    serialFramePut32(out + 8, h.timestamp);
+    serialFramePut32(out + 12, h.length);
+    serialFramePut32(out + 16, h.crc);
+}
+
+/**
+ * @brief Decode a header from SERIAL_FRAME_HEADER_SIZE bytes at `in`.
+ *
+ * Returns false when the magic does not match or the length is out of range.
+ */
+inline bool serialFrameDecode(const uint8_t *in, SerialFrameHeader &h)
+{
+    if (memcmp(in, SERIAL_FRAME_MAGIC, 4) != 0)
+        return false;
+    h.seq = serialFrameGet32(in + 4);
+    h.timestamp = serialFrameGet32(in + 8);
+    h.length = serialFrameGet32(in + 12);
+    h.crc = serialFrameGet32(in + 16);
+    return h.length > 0 && h.length <= SERIAL_FRAME_MAX_PAYLOAD;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file serial_sink.h
+ * @brief Block writes to Serial that wait only when the TX buffer is full.
+ *
+ * The camera sketches used to pace the link with `delayMicroseconds()`
+ * after every byte. SerialSink instead asks `availableForWrite()` how much
+ * room the TX buffer has and hands the core that many bytes at once, so
+ * the sketch only waits when the buffer is actually full and the UART runs
+ * back to back at the configured baud rate.
+ *
+ * If a core reports no room (or does not implement `availableForWrite()`,
+ * which then returns 0), a single byte is written; the core's `write()`
+ * normally blocks until it fits. A port that accepts nothing for
+ * SERIAL_SINK_STALL_MS (closed, or stuck) ends the block instead of hanging
+ * the sketch: `write()` returns false, which stops the FIFO read, and the
+ * block counts as dropped.
+ *
+ * Measurement mode: call `beginMeasure()` before a transfer and
+ * `report()` after it to print the effective bytes/s against the
+ * theoretical rate of the baud (10 bits per byte for 8N1).
+ *
+ * It is a FrameSink, so CameraPipeline streams FIFO blocks straight into it.
+ *
+ * Usage:
+ *   SerialSink sink(Serial, 921600);
+ *   sink.write(header, sizeof(header));
+ *   camera.send(sink);
+ */
+#pragma once
+
+#include <Arduino.h>
+#include "camera_pipeline.h"
+
+/** Give up on a block when the port has accepted nothing for this long (ms). */
+#ifndef SERIAL_SINK_STALL_MS
+#define SERIAL_SINK_STALL_MS 500
+#endif
+
+class SerialSink : public FrameSink
+{
+public:
+    SerialSink(Print &port, uint32_t baud)
+        : _port(port), _baud(baud), _bytes(0), _waits(0), _drops(0), _startedAt(0)
+    {
+    }
+
+    /**
+     * @brief Write `n` bytes, in blocks as large as the TX buffer allows.
+     *
+     * Returns false, stopping the read, only when the port stalls.
+     */
+    bool write(uint8_t *buf, size_t n) override
+    {
+        unsigned long progressAt = millis();
+        while (n)
+        {
+            int room = _port.availableForWrite();
+            size_t chunk = (room > 0) ? (size_t)room : 1;
+            if (room <= 0)
+                _waits++;
+            if (chunk > n)
+                chunk = n;
+            size_t written = _port.write(buf, chunk);
+            if (written == 0)
+            {
+                if (millis() - progressAt > SERIAL_SINK_STALL_MS)
+                {
+                    _drops++;
+                    return false;
+                }
+                continue;
+            }
+            progressAt = millis();
+            _bytes += written;
+            buf += written;
+            n -= written;
+        }
+        return true;
+    }
+
+    void write(uint8_t b) { write(&b, 1); }
+
+    /** Block until everything written has left the TX buffer. */
+    void flush() { _port.flush(); }
+
+    /** Blocks abandoned because the port stalled, since the last `beginMeasure()`. */
+    uint32_t drops() const { return _drops; }
+
+    /** Start a measured transfer. */
+    void beginMeasure()
+    {
+        _bytes = 0;
+        _waits = 0;
+        _drops = 0;
+        _startedAt = micros();
+    }
+
+    /**
+     * @brief Print the measured transfer as one line to `out`:
+     * "<prefix><bytes> B in <ms> ms = <B/s> B/s (<pct>% of <baud> baud), <waits> waits, <drops> dropped<suffix>".
+     *
+     * Flushes first so the time covers the bytes actually sent.
+     */
+    void report(Print &out, const char *prefix = "", const char *suffix = "")
+    {
+        flush();
+        unsigned long us = micros() - _startedAt;
+        if (us == 0)
+            us = 1;
+        uint32_t rate = (uint32_t)((uint64_t)_bytes * 1000000UL / us);
+        uint32_t pct = (uint32_t)((uint64_t)rate * 1000 / _baud); // bytes/s * 10 bits * 100% / baud
+        out.print(prefix);
+        out.print(_bytes);
+        out.print(" B in ");
+        out.print(us / 1000);
+        out.print(" ms = ");
+        out.print(rate);
+        out.print(" B/s (");
+        out.print(pct);
+        out.print("% of ");
+        out.print(_baud);
+        out.print(" baud), ");
+        out.print(_waits);
+        out.print(" waits, ");
+        out.print(_drops);
+        out.print(" dropped");
+        out.println(suffix);
+    }
+
+private:
+    Print &_port;
+    uint32_t _baud;
+    uint32_t _bytes;
+    uint32_t _waits;
+    uint32_t _drops;
+    unsigned long _startedAt;
+};
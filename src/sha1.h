@@ -0,0 +1,125 @@
+/**
+ * @file sha1.h
+ * @brief SHA-1 (FIPS 180-4) for the WebSocket opening handshake.
+ *
+ * RFC 6455 derives `Sec-WebSocket-Accept` from the SHA-1 of the client's
+ * key; nothing else here needs a hash, and SHA-1 is not used for security.
+ * One 64-byte block buffer, no tables. Plain C++, shared with the host tools.
+ *
+ * Usage:
+ *   Sha1 sha;
+ *   sha.update(data, n);
+ *   uint8_t digest[Sha1::DIGEST_SIZE];
+ *   sha.final(digest);
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Sha1
+{
+public:
+    static const size_t DIGEST_SIZE = 20;
+
+    Sha1() : _length(0), _fill(0)
+    {
+        _h[0] = 0x67452301;
+        _h[1] = 0xEFCDAB89;
+        _h[2] = 0x98BADCFE;
+        _h[3] = 0x10325476;
+        _h[4] = 0xC3D2E1F0;
+    }
+
+    void update(const uint8_t *data, size_t n)
+    {
+        _length += n;
+        while (n--)
+        {
+            _block[_fill++] = *data++;
+            if (_fill == 64)
+            {
+                compress();
+                _fill = 0;
+            }
+        }
+    }
+
+    /** Pad, finish and write the 20-byte digest. The object is spent afterwards. */
+    void final(uint8_t *digest)
+    {
+        uint64_t bits = _length * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (_fill != 56)
+            update(&pad, 1);
+        for (int i = 7; i >= 0; --i)
+        {
+            uint8_t b = (uint8_t)(bits >> (i * 8));
+            update(&b, 1);
+        }
+        for (int i = 0; i < 5; ++i)
+        {
+            digest[i * 4] = (uint8_t)(_h[i] >> 24);
+            digest[i * 4 + 1] = (uint8_t)(_h[i] >> 16);
+            digest[i * 4 + 2] = (uint8_t)(_h[i] >> 8);
+            digest[i * 4 + 3] = (uint8_t)_h[i];
+        }
+    }
+
+private:
+    static uint32_t rol(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+    void compress()
+    {
+        // 16-word rolling message schedule instead of 80 words.
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i)
+            w[i] = ((uint32_t)_block[i * 4] << 24) | ((uint32_t)_block[i * 4 + 1] << 16) |
+                   ((uint32_t)_block[i * 4 + 2] << 8) | _block[i * 4 + 3];
+        uint32_t a = _h[0], b = _h[1], c = _h[2], d = _h[3], e = _h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            if (i >= 16)
+                w[i & 15] = rol(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        _h[0] += a;
+        _h[1] += b;
+        _h[2] += c;
+        _h[3] += d;
+        _h[4] += e;
+    }
+
+    uint32_t _h[5];
+    uint64_t _length;
+    uint8_t _block[64];
+    uint8_t _fill;
+};
@@ -0,0 +1,297 @@
+/**
+ * @file websocket.h
+ * @brief Minimal RFC 6455 WebSocket server side for a few dashboard clients.
+ *
+ * The HTTP server routes the upgrade request to a handler, which checks
+ * `Sec-WebSocket-Version` (only 13) and `wsOriginAllowed()`, then calls
+ * `accept()` with the client's `Sec-WebSocket-Key`: the 101 response goes
+ * out in one write and the socket joins a table of WS_MAX_CLIENTS. From
+ * then on `poll()`, first thing in each loop pass, reads one pending frame
+ * per socket through `service()` (the HTTP server's claim handler also
+ * calls it for data it sees first):
+ *   - text: passed to the text handler (commands are a few bytes)
+ *   - ping: answered with a pong carrying the same payload, up to 125 bytes
+ *   - close: answered with a close and the client dropped
+ *   - binary and continuation frames are ignored
+ * Client frames must be masked and at most WS_MAX_PAYLOAD bytes; anything
+ * else closes the connection (1002 / 1009).
+ *
+ * `broadcast()` sends one unmasked binary frame to every client, header and
+ * payload in a single write. `tick()` pings a quiet connection every
+ * WS_PING_MS so dead clients are found by the failed write.
+ *
+ * Usage:
+ *   ws.onText(handleCommand);
+ *   if (!ws.accept(client, key)) ...         // in the `/ws` route handler
+ *   ws.broadcast(frame, sizeof(frame));
+ *   // in loop():
+ *   ws.poll();                                // first, before anything slow
+ *   ws.tick();
+ */
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiS3.h>
+#include "base64.h"
+#include "sha1.h"
+
+#ifndef WS_MAX_CLIENTS
+#define WS_MAX_CLIENTS 2
+#endif
+/** Largest client frame payload accepted (bytes); 125 is the most a ping may carry. */
+#ifndef WS_MAX_PAYLOAD
+#define WS_MAX_PAYLOAD 125
+#endif
+/** Largest server frame payload sent (bytes); at least WS_MAX_PAYLOAD so pongs echo the whole ping. */
+#ifndef WS_MAX_SEND
+#define WS_MAX_SEND 125
+#endif
+/** Ping a connection that has been quiet this long (ms). */
+#ifndef WS_PING_MS
+#define WS_PING_MS 20000
+#endif
+
+static_assert(WS_MAX_SEND >= WS_MAX_PAYLOAD && WS_MAX_SEND <= 125, "pongs echo the ping in a one-byte length frame");
+
+/**
+ * @brief Whether a browser page at `origin` may open a socket on `host`.
+ *
+ * Browsers send `Origin` with every WebSocket upgrade and do not apply the
+ * same-origin policy to it, so any page the user visits could otherwise
+ * switch the pump. Only the dashboard's own origin (scheme stripped, equal
+ * to the `Host` header) is allowed; a missing `Origin` means a non-browser
+ * client, which must still pass Basic Auth.
+ */
+inline bool wsOriginAllowed(const String &origin, const String &host)
+{
+    if (origin.length() == 0)
+        return true;
+    int scheme = origin.indexOf("://");
+    if (scheme < 0 || host.length() == 0)
+        return false;
+    return origin.substring(scheme + 3).equalsIgnoreCase(host);
+}
+
+class WebSocketHub
+{
+public:
+    /** Called with the payload of each text frame and the client that sent it. */
+    typedef void (*TextHandler)(WiFiClient &client, const char *text, size_t n);
+
+    WebSocketHub() : _onText(nullptr), _count(0), _lastSentAt(0), _receivedAt(0)
+    {
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; ++i)
+            _clients[i].active = false;
+    }
+
+    void onText(TextHandler handler) { _onText = handler; }
+
+    /** Clients connected. */
+    uint8_t count() const { return _count; }
+
+    /**
+     * @brief Complete the opening handshake and take over the client.
+     *
+     * Returns false when the table is full; nothing has been sent then, so
+     * the caller can still answer with an HTTP error.
+     */
+    bool accept(WiFiClient &client, const String &key)
+    {
+        Slot *slot = nullptr;
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS && !slot; ++i)
+            if (!_clients[i].active)
+                slot = &_clients[i];
+        if (!slot)
+            return false;
+
+        static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        Sha1 sha;
+        sha.update((const uint8_t *)key.c_str(), key.length());
+        sha.update((const uint8_t *)GUID, sizeof(GUID) - 1);
+        uint8_t digest[Sha1::DIGEST_SIZE];
+        sha.final(digest);
+        char accept[32];
+        base64Encode(digest, sizeof(digest), accept);
+
+        char head[160];
+        int n = snprintf(head, sizeof(head),
+                         "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: %s\r\n\r\n",
+                         accept);
+        if (client.write((const uint8_t *)head, n) != (size_t)n)
+            return false;
+        slot->client = client;
+        slot->active = true;
+        _count++;
+        return true;
+    }
+
+    /** Read one pending frame from each client. Call at the top of loop() so commands do not wait. */
+    void poll()
+    {
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; ++i)
+            if (_clients[i].active && _clients[i].client.available() > 0)
+                service(_clients[i].client);
+    }
+
+    /** micros() when the frame being handled started to be read; for the text handler's latency figures. */
+    unsigned long receivedAt() const { return _receivedAt; }
+
+    /** True if `client` is one of ours. */
+    bool owns(const WiFiClient &client) const { return find(client) != nullptr; }
+
+    /**
+     * @brief Read one frame from `client` if it is one of ours.
+     *
+     * Returns false for a client that is not a WebSocket, so the caller can
+     * treat the data as an HTTP request.
+     */
+    bool service(WiFiClient &client)
+    {
+        Slot *slot = find(client);
+        if (!slot)
+            return false;
+        _receivedAt = micros();
+        slot->client.setTimeout(100);
+        uint8_t hdr[2];
+        if (!readExact(slot->client, hdr, 2))
+        {
+            drop(*slot);
+            return true;
+        }
+        uint8_t opcode = hdr[0] & 0x0F;
+        bool masked = hdr[1] & 0x80;
+        uint32_t length = hdr[1] & 0x7F;
+        if (length == 126)
+        {
+            uint8_t ext[2];
+            if (!readExact(slot->client, ext, 2))
+            {
+                drop(*slot);
+                return true;
+            }
+            length = ((uint32_t)ext[0] << 8) | ext[1];
+        }
+        else if (length == 127)
+        {
+            length = WS_MAX_PAYLOAD + 1;
+        }
+        if (!masked || length > WS_MAX_PAYLOAD)
+        {
+            close(*slot, masked ? 1009 : 1002);
+            return true;
+        }
+        uint8_t mask[4];
+        uint8_t payload[WS_MAX_PAYLOAD];
+        if (!readExact(slot->client, mask, 4) || !readExact(slot->client, payload, length))
+        {
+            drop(*slot);
+            return true;
+        }
+        for (uint32_t i = 0; i < length; ++i)
+            payload[i] ^= mask[i & 3];
+
+        switch (opcode)
+        {
+        case 0x1: // text
+            if (_onText)
+                _onText(slot->client, (const char *)payload, length);
+            break;
+        case 0x8: // close
+            close(*slot, 1000);
+            break;
+        case 0x9: // ping
+            sendFrame(*slot, 0xA, payload, length);
+            break;
+        default: // pong, binary and continuation frames carry nothing for us
+            break;
+        }
+        return true;
+    }
+
+    /** Send a binary frame to every client. */
+    void broadcast(const uint8_t *data, size_t n)
+    {
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; ++i)
+            if (_clients[i].active)
+                sendFrame(_clients[i], 0x2, data, n);
+        _lastSentAt = millis();
+    }
+
+    /** Send a text frame to one client (e.g. an error reply to its command). */
+    void sendText(WiFiClient &client, const char *text)
+    {
+        Slot *slot = find(client);
+        size_t n = strlen(text);
+        if (slot)
+            sendFrame(*slot, 0x1, (const uint8_t *)text, n > WS_MAX_SEND ? WS_MAX_SEND : n);
+    }
+
+    /** Ping quiet connections; clients whose write fails are dropped. */
+    void tick()
+    {
+        if (_count == 0 || millis() - _lastSentAt < WS_PING_MS)
+            return;
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; ++i)
+            if (_clients[i].active)
+                sendFrame(_clients[i], 0x9, nullptr, 0);
+        _lastSentAt = millis();
+    }
+
+private:
+    struct Slot
+    {
+        WiFiClient client;
+        bool active;
+    };
+
+    Slot *find(const WiFiClient &client)
+    {
+        for (uint8_t i = 0; i < WS_MAX_CLIENTS; ++i)
+            if (_clients[i].active && _clients[i].client == client)
+                return &_clients[i];
+        return nullptr;
+    }
+
+    const Slot *find(const WiFiClient &client) const { return const_cast<WebSocketHub *>(this)->find(client); }
+
+    static bool readExact(WiFiClient &client, uint8_t *buf, size_t n)
+    {
+        return n == 0 || client.readBytes(buf, n) == n;
+    }
+
+    /** One unmasked frame (FIN set), header and payload in one write. */
+    void sendFrame(Slot &slot, uint8_t opcode, const uint8_t *data, size_t n)
+    {
+        uint8_t frame[2 + WS_MAX_SEND];
+        if (n > WS_MAX_SEND)
+            return;
+        frame[0] = 0x80 | opcode;
+        frame[1] = (uint8_t)n;
+        if (n)
+            memcpy(frame + 2, data, n);
+        if (slot.client.write(frame, n + 2) != n + 2)
+            drop(slot);
+    }
+
+    void close(Slot &slot, uint16_t code)
+    {
+        uint8_t status[2] = {(uint8_t)(code >> 8), (uint8_t)code};
+        sendFrame(slot, 0x8, status, 2);
+        if (slot.active)
+            drop(slot);
+    }
+
+    void drop(Slot &slot)
+    {
+        slot.client.stop();
+        slot.active = false;
+        _count--;
+    }
+
+    TextHandler _onText;
+    Slot _clients[WS_MAX_CLIENTS];
+    uint8_t _count;
+    unsigned long _lastSentAt;
+    unsigned long _receivedAt;
+};
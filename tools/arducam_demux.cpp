@@ -0,0 +1,514 @@
+/**
+ * @file arducam_demux.cpp
+ * @brief Split the ArduCAM example's serial output into messages, JPEGs and BMPs.
+ *
+ * `src/Arducam Example.h` writes everything to one serial stream:
+ *
+ *   - text lines: "ACK CMD <message> END", plus a bare decimal length
+ *     before each single-shot JPEG (mode 1)
+ *   - "ACK IMG END" followed by a raw JPEG (SOI..EOI) in modes 1 and 2
+ *   - 0xFF 0xAA, a BMP (RGB565 or 8-bit gray, see bmp_rows.h), 0xBB 0xCC in mode 3
+ *
+ * The Demux parses this in a single pass over a MirrorRing. JPEGs are
+ * framed with the firmware's JpegFramer, fed only the newly arrived bytes.
+ * BMP length is taken from the BMP header, because pixel data can contain
+ * any byte pattern. Each message or frame is passed to a callback as a
+ * pointer into the ring with the time its first byte was read. A frame that
+ * loses its EOI is cut off at the next "ACK " line instead of swallowing
+ * the frames after it.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o arducam_demux tools/arducam_demux.cpp
+ *
+ * Usage:
+ *   arducam_demux /dev/ttyACM0 --out frames/
+ *   arducam_demux capture.bin --out frames/
+ *   arducam_demux capture.bin --bench 20
+ */
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jpeg_framer.h"
+#include "mirror_ring.h"
+
+/** Payload bytes per second of a 921600 baud 8N1 link (10 bits per byte). */
+static const double LINK_BYTES_PER_SEC = 921600.0 / 10.0;
+/** Largest JPEG accepted: the ArduCAM FIFO size. */
+static const size_t MAX_JPEG = 0x7FFFF;
+/** Largest BMP accepted (header + pixels). */
+static const size_t MAX_BMP = 1 << 20;
+/** Text lines longer than this are treated as noise. */
+static const size_t MAX_LINE = 256;
+/** Smallest BMP header the sketch writes (RGB565, BmpRowSink::HEADER_RGB565). */
+static const size_t BMP_HEADER = 66;
+
+struct DemuxEvent
+{
+    enum Kind
+    {
+        CONTROL, ///< "ACK CMD ... END"; data is the message between the markers
+        TEXT,    ///< Any other line
+        JPEG,    ///< Complete SOI..EOI JPEG
+        BMP      ///< BMP file (header + pixels), without the 0xFF 0xAA / 0xBB 0xCC markers
+    };
+    Kind kind;
+    struct timespec time; ///< CLOCK_REALTIME when the first byte was read
+    const uint8_t *data;  ///< Valid only during the callback
+    size_t length;
+};
+
+struct DemuxStats
+{
+    uint64_t control = 0;
+    uint64_t text = 0;
+    uint64_t jpeg = 0;
+    uint64_t bmp = 0;
+    uint64_t frameBytes = 0;
+    uint64_t jpegDropped = 0;    ///< No SOI, no EOI before the next message, or too large
+    uint64_t bmpDropped = 0;     ///< Bad header or missing 0xBB 0xCC trailer
+    uint64_t lengthMismatch = 0; ///< Mode 1 length line disagrees with the framed JPEG
+    uint64_t skippedBytes = 0;   ///< Noise outside any line or frame
+};
+
+class Demux
+{
+public:
+    using Callback = std::function<void(const DemuxEvent &)>;
+
+    explicit Demux(Callback cb) : _cb(std::move(cb)) {}
+
+    /** Note the arrival time of the bytes about to be parsed. */
+    void setTime(const struct timespec &now) { _now = now; }
+
+    /** Consume everything complete in the ring; partial data stays for the next call. */
+    void parse(MirrorRing &ring)
+    {
+        while (step(ring))
+        {
+        }
+    }
+
+    /** Forget any partial message or frame (the ring is being cleared). Counters are kept. */
+    void reset()
+    {
+        _state = TEXT_STATE;
+        _scanned = 0;
+        _lengthHint = 0;
+    }
+
+    const DemuxStats &stats() const { return _stats; }
+
+private:
+    enum State
+    {
+        TEXT_STATE,
+        JPEG_STATE,
+        BMP_STATE
+    };
+
+    /** Advance the state machine once. Returns false when more data is needed. */
+    bool step(MirrorRing &ring)
+    {
+        switch (_state)
+        {
+        case JPEG_STATE:
+            return stepJpeg(ring);
+        case BMP_STATE:
+            return stepBmp(ring);
+        default:
+            return stepText(ring);
+        }
+    }
+
+    bool stepText(MirrorRing &ring)
+    {
+        const uint8_t *p = ring.readPtr();
+        size_t avail = ring.used();
+        if (avail < 2)
+            return false;
+        if (p[0] == 0xFF && p[1] == 0xAA)
+        {
+            enter(BMP_STATE);
+            return true;
+        }
+
+        size_t limit = avail < MAX_LINE ? avail : MAX_LINE;
+        const uint8_t *nl = (const uint8_t *)memchr(p, '\n', limit);
+        if (!nl)
+        {
+            if (avail < MAX_LINE)
+                return false;
+            // No line ending: skip to the next possible BMP marker.
+            const uint8_t *ff = (const uint8_t *)memchr(p + 1, 0xFF, limit - 1);
+            size_t n = ff ? (size_t)(ff - p) : limit;
+            _stats.skippedBytes += n;
+            ring.consume(n);
+            return true;
+        }
+
+        size_t len = nl - p;
+        if (len && p[len - 1] == '\r')
+            len--;
+        line(p, len);
+        ring.consume(nl - p + 1);
+        return true;
+    }
+
+    void line(const uint8_t *p, size_t len)
+    {
+        static const char CMD[] = "ACK CMD ";
+        static const char END[] = " END";
+        static const char IMG[] = "ACK IMG END";
+        const char *s = (const char *)p;
+
+        if (len == sizeof(IMG) - 1 && !memcmp(s, IMG, len))
+        {
+            enter(JPEG_STATE);
+            _framer.begin();
+            _scanned = 0;
+            return;
+        }
+        if (len >= sizeof(CMD) - 1 + sizeof(END) - 1 && !memcmp(s, CMD, sizeof(CMD) - 1) &&
+            !memcmp(s + len - (sizeof(END) - 1), END, sizeof(END) - 1))
+        {
+            _stats.control++;
+            emit(DemuxEvent::CONTROL, p + sizeof(CMD) - 1, len - (sizeof(CMD) - 1) - (sizeof(END) - 1), _now);
+            return;
+        }
+        if (len > 0 && len <= 7 && strspn(s, "0123456789") >= len)
+        {
+            _lengthHint = strtoul(std::string(s, len).c_str(), nullptr, 10);
+            return;
+        }
+        if (len == 0)
+            return;
+        _stats.text++;
+        emit(DemuxEvent::TEXT, p, len, _now);
+    }
+
+    bool stepJpeg(MirrorRing &ring)
+    {
+        const uint8_t *p = ring.readPtr();
+        size_t avail = ring.used();
+        if (avail == _scanned)
+            return false;
+
+        // The firmware starts every message with "ACK "; one inside the JPEG means its EOI was lost.
+        size_t from = _scanned > 4 ? _scanned - 4 : 0;
+        const uint8_t *ack = (const uint8_t *)memmem(p + from, avail - from, "\nACK ", 5);
+        size_t end = ack ? (size_t)(ack - p) : avail;
+        if (end > _scanned)
+            _framer.feed(p + _scanned, end - _scanned);
+        if (!_framer.done())
+        {
+            _scanned = avail;
+            if (!ack && _scanned <= MAX_JPEG)
+                return false;
+            _framer.end();
+            dropJpeg(ring, ack ? end + 1 : avail);
+            return true;
+        }
+
+        _scanned = avail;
+        if (!_framer.end())
+        {
+            dropJpeg(ring, 0); // no SOI: let the text parser have the bytes
+            return true;
+        }
+        uint32_t start = _framer.start();
+        uint32_t len = _framer.length();
+        if (_lengthHint && _lengthHint != len)
+            _stats.lengthMismatch++;
+        _lengthHint = 0;
+        _stats.jpeg++;
+        _stats.frameBytes += len;
+        emit(DemuxEvent::JPEG, p + start, len, _frameTime);
+        _stats.skippedBytes += start;
+        ring.consume(start + len);
+        _state = TEXT_STATE;
+        return true;
+    }
+
+    void dropJpeg(MirrorRing &ring, size_t consume)
+    {
+        _stats.jpegDropped++;
+        _stats.skippedBytes += consume;
+        ring.consume(consume);
+        _lengthHint = 0;
+        _state = TEXT_STATE;
+    }
+
+    bool stepBmp(MirrorRing &ring)
+    {
+        const uint8_t *p = ring.readPtr();
+        size_t avail = ring.used();
+        if (avail < 2 + BMP_HEADER)
+            return false;
+
+        const uint8_t *bmp = p + 2;
+        size_t total = bmpSize(bmp);
+        if (total == 0)
+        {
+            dropBmp(ring, 2);
+            return true;
+        }
+        if (avail < 2 + total + 2)
+            return false;
+        if (bmp[total] != 0xBB || bmp[total + 1] != 0xCC)
+        {
+            dropBmp(ring, 2);
+            return true;
+        }
+        _stats.bmp++;
+        _stats.frameBytes += total;
+        emit(DemuxEvent::BMP, bmp, total, _frameTime);
+        ring.consume(2 + total + 2);
+        _state = TEXT_STATE;
+        return true;
+    }
+
+    void dropBmp(MirrorRing &ring, size_t consume)
+    {
+        _stats.bmpDropped++;
+        _stats.skippedBytes += consume;
+        ring.consume(consume);
+        _state = TEXT_STATE;
+    }
+
+    /** Header plus pixel bytes of the BMP at `h`, or 0 when the header is not plausible. */
+    static size_t bmpSize(const uint8_t *h)
+    {
+        auto le32 = [h](size_t o) {
+            return (uint32_t)h[o] | ((uint32_t)h[o + 1] << 8) | ((uint32_t)h[o + 2] << 16) | ((uint32_t)h[o + 3] << 24);
+        };
+        if (h[0] != 'B' || h[1] != 'M')
+            return 0;
+        uint32_t offset = le32(10);
+        int32_t width = (int32_t)le32(18);
+        int32_t height = (int32_t)le32(22);
+        uint16_t bpp = h[28] | (h[29] << 8);
+        if (height < 0)
+            height = -height;
+        if (offset < BMP_HEADER || width <= 0 || height == 0 || (bpp != 8 && bpp != 16 && bpp != 24))
+            return 0;
+        // Rows are padded to a multiple of 4 bytes.
+        uint64_t stride = ((uint64_t)width * bpp + 31) / 32 * 4;
+        uint64_t size = offset + stride * height;
+        return size <= MAX_BMP ? (size_t)size : 0;
+    }
+
+    void enter(State s)
+    {
+        _state = s;
+        _frameTime = _now;
+    }
+
+    void emit(DemuxEvent::Kind kind, const uint8_t *data, size_t len, const struct timespec &t)
+    {
+        if (_cb)
+            _cb(DemuxEvent{kind, t, data, len});
+    }
+
+    Callback _cb;
+    State _state = TEXT_STATE;
+    JpegFramer _framer;
+    size_t _scanned = 0;       ///< JPEG bytes already fed to the framer
+    uint32_t _lengthHint = 0;  ///< Length line preceding a mode 1 JPEG
+    struct timespec _now = {};
+    struct timespec _frameTime = {};
+    DemuxStats _stats;
+};
+
+/** Writes frames to `dir` and control messages to stdout. */
+class DiskSink
+{
+public:
+    explicit DiskSink(std::string dir) : _dir(std::move(dir)) {}
+
+    void operator()(const DemuxEvent &e)
+    {
+        long long ms = (long long)e.time.tv_sec * 1000 + e.time.tv_nsec / 1000000;
+        if (e.kind == DemuxEvent::CONTROL || e.kind == DemuxEvent::TEXT)
+        {
+            printf("%lld %s %.*s\n", ms, e.kind == DemuxEvent::CONTROL ? "CMD" : "TXT", (int)e.length,
+                   (const char *)e.data);
+            return;
+        }
+        if (_dir.empty())
+            return;
+        char name[64];
+        snprintf(name, sizeof(name), "/%06llu_%lld.%s", (unsigned long long)_count++, ms,
+                 e.kind == DemuxEvent::JPEG ? "jpg" : "bmp");
+        std::string path = _dir + name;
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            perror(path.c_str());
+            return;
+        }
+        size_t off = 0;
+        while (off < e.length)
+        {
+            ssize_t w = write(fd, e.data + off, e.length - off);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+            {
+                perror(path.c_str());
+                break;
+            }
+            off += (size_t)w;
+        }
+        close(fd);
+    }
+
+private:
+    std::string _dir;
+    uint64_t _count = 0;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) { stopRequested = 1; }
+
+/** Put a tty into raw 8N1 mode at 921600 baud. Not an error for regular files. */
+static bool configureSerial(int fd)
+{
+    if (!isatty(fd))
+        return true;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B921600);
+    cfsetospeed(&tio, B921600);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+/** Read `fd` to EOF (or until interrupted) through the ring. Returns bytes read. */
+static uint64_t pump(int fd, MirrorRing &ring, Demux &demux)
+{
+    uint64_t total = 0;
+    while (!stopRequested)
+    {
+        ssize_t n = read(fd, ring.writePtr(), ring.space());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        demux.setTime(now);
+        ring.produce((size_t)n);
+        total += (uint64_t)n;
+        demux.parse(ring);
+    }
+    return total;
+}
+
+static void printStats(const DemuxStats &s)
+{
+    fprintf(stderr,
+            "control %llu, text %llu, jpeg %llu, bmp %llu, frame bytes %llu, jpeg dropped %llu, bmp dropped %llu, "
+            "length mismatch %llu, skipped %llu bytes\n",
+            (unsigned long long)s.control, (unsigned long long)s.text, (unsigned long long)s.jpeg,
+            (unsigned long long)s.bmp, (unsigned long long)s.frameBytes, (unsigned long long)s.jpegDropped,
+            (unsigned long long)s.bmpDropped, (unsigned long long)s.lengthMismatch,
+            (unsigned long long)s.skippedBytes);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s <tty|file> [--out DIR] [--bench N]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    std::string outDir;
+    int benchRuns = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            outDir = argv[++i];
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+            benchRuns = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !input)
+            input = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!input)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = open(input, O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !configureSerial(fd))
+    {
+        perror(input);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // A whole frame must fit in the ring so it can be handed out in place.
+    MirrorRing ring(2 * (MAX_JPEG > MAX_BMP ? MAX_JPEG : MAX_BMP));
+
+    if (benchRuns <= 0)
+    {
+        DiskSink disk(outDir);
+        Demux demux(std::ref(disk));
+        pump(fd, ring, demux);
+        fflush(stdout);
+        printStats(demux.stats());
+        close(fd);
+        return 0;
+    }
+
+    if (isatty(fd))
+    {
+        fprintf(stderr, "--bench needs a recorded file\n");
+        return 2;
+    }
+    // Messages are not printed while benchmarking; frames are written only with --out.
+    DiskSink disk(outDir);
+    Demux demux([&](const DemuxEvent &e) {
+        if (e.kind == DemuxEvent::JPEG || e.kind == DemuxEvent::BMP)
+            disk(e);
+    });
+    uint64_t bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int run = 0; run < benchRuns && !stopRequested; ++run)
+    {
+        lseek(fd, 0, SEEK_SET);
+        ring.clear();
+        demux.reset();
+        bytes += pump(fd, ring, demux);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    close(fd);
+
+    printStats(demux.stats());
+    double rate = secs > 0 ? bytes / secs : 0;
+    fprintf(stderr, "bench: %d runs, %llu bytes in %.3f s = %.1f MB/s (%.0fx a 921600 baud link)\n", benchRuns,
+            (unsigned long long)bytes, secs, rate / 1e6, rate / LINK_BYTES_PER_SEC);
+    return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file cam_fifo_bench.cpp
+ * @brief Model FIFO-to-client throughput: per-byte SPI reads vs buffer transfers.
+ *
+ * Replays `/image` read-outs against the mocked SPI bus, ArduCAM and
+ * WiFiClient in tools/host/. Two read-outs are compared for each frame:
+ *   - per-byte: the original handleImage loop, one `SPI.transfer(0x00)`
+ *     per byte at the default SPI clock, a `client.write()` per 64-byte
+ *     chunk and `delayMicroseconds(50)` after each chunk
+ *   - burst: `CameraPipeline::sendRange()` through cam_fifo.h, one buffer
+ *     transfer per CAM_BURST_CHUNK bytes at CAM_SPI_CLOCK, into a PrintSink
+ *
+ * The mocks advance a simulated clock by a modelled cost per call, so the
+ * times are only as good as the model parameters; the defaults are
+ * assumptions, to be replaced with figures measured on the board. The
+ * bench also checks that the client received exactly the FIFO bytes, and
+ * that a client whose write of the final block fails leaves `sendRange()`
+ * reporting an incomplete transfer, with no chunked terminator sent.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Itools/host -Isrc -o cam_fifo_bench tools/cam_fifo_bench.cpp
+ *
+ * Usage:
+ *   cam_fifo_bench                         # synthetic 8, 24 and 64 KiB frames
+ *   cam_fifo_bench frame1.jpg frame2.jpg   # recorded frames or FIFO dumps
+ *   cam_fifo_bench --spi-call-us 2 --write-us 400 --link-kbps 150
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <ArduCAM.h>
+#include "camera_pipeline.h"
+
+/** Mocked WiFiClient: counts writes, keeps the data and models the AT bridge cost. */
+class MockClient : public Print
+{
+public:
+    MockClient(double writeUs, double linkBytesPerSec) : _writeUs(writeUs), _linkBytesPerSec(linkBytesPerSec) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t n) override
+    {
+        writes++;
+        data.append((const char *)buf, n);
+        hostAdvance(_writeUs + n * 1e6 / _linkBytesPerSec);
+        return n;
+    }
+    using Print::write;
+
+    unsigned writes = 0;
+    std::string data;
+
+private:
+    double _writeUs;
+    double _linkBytesPerSec;
+};
+
+/** A client that accepts its first `accept` writes, then fails every write, like a closed socket. */
+class FailingClient : public Print
+{
+public:
+    explicit FailingClient(unsigned accept) : _accept(accept) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t n) override
+    {
+        if (_accept == 0)
+            return 0;
+        _accept--;
+        data.append((const char *)buf, n);
+        return n;
+    }
+    using Print::write;
+
+    std::string data;
+
+private:
+    unsigned _accept;
+};
+
+/**
+ * @brief Send `size` FIFO bytes chunked to a client that fails on the final block.
+ *
+ * Returns true when `sendRange()` reports the transfer incomplete and the
+ * terminating chunk was not written.
+ */
+static bool finalBlockRejected(size_t size)
+{
+    std::vector<uint8_t> fifo(size, 0x5A);
+    ArduCAM cam(OV2640, 10);
+    cam.fifoLength = fifo.size();
+    SPI.load(fifo.data(), fifo.size());
+    unsigned blocks = (unsigned)((size + CAM_BURST_CHUNK - 1) / CAM_BURST_CHUNK);
+    FailingClient client(blocks - 1);
+    CameraPipeline camera(cam);
+    PrintSink sink(client, true);
+    bool complete = camera.sendRange(sink, 0, fifo.size());
+    return !complete && client.data.find("0\r\n\r\n") == std::string::npos;
+}
+
+struct Result
+{
+    double totalUs;
+    double spiUs;
+    uint64_t spiCalls;
+    unsigned writes;
+    bool same;
+};
+
+/** The original handleImage read-out (baseline firmware). */
+static void readPerByte(ArduCAM &cam, MockClient &client, uint32_t len)
+{
+    const size_t BUF_SZ = 64;
+    cam.CS_LOW();
+    cam.set_fifo_burst();
+    uint8_t buf[BUF_SZ];
+    uint32_t remaining = len;
+    while (remaining)
+    {
+        size_t toRead = (remaining > BUF_SZ) ? BUF_SZ : remaining;
+        for (size_t i = 0; i < toRead; ++i)
+            buf[i] = SPI.transfer(0x00);
+        client.write(buf, toRead);
+        remaining -= toRead;
+        delayMicroseconds(50);
+    }
+    cam.CS_HIGH();
+}
+
+static Result run(const std::vector<uint8_t> &fifo, bool burst, double writeUs, double linkBytesPerSec)
+{
+    ArduCAM cam(OV2640, 10);
+    cam.fifoLength = fifo.size();
+    SPI.load(fifo.data(), fifo.size());
+    SPI.resetCounters();
+    MockClient client(writeUs, linkBytesPerSec);
+    double t0 = hostClockUs();
+    if (burst)
+    {
+        CameraPipeline camera(cam);
+        PrintSink sink(client);
+        camera.sendRange(sink, 0, fifo.size());
+    }
+    else
+    {
+        readPerByte(cam, client, fifo.size());
+    }
+    Result r;
+    r.totalUs = hostClockUs() - t0;
+    r.spiUs = SPI.busyUs;
+    r.spiCalls = SPI.calls;
+    r.writes = client.writes;
+    r.same = client.data.size() == fifo.size() && memcmp(client.data.data(), fifo.data(), fifo.size()) == 0;
+    return r;
+}
+
+/** A JPEG-shaped synthetic frame: SOI, pseudo-random data, EOI. */
+static std::vector<uint8_t> syntheticFrame(size_t n)
+{
+    std::vector<uint8_t> f(n);
+    uint32_t x = 0x12345678u ^ (uint32_t)n;
+    for (size_t i = 0; i < n; ++i)
+    {
+        x = x * 1664525u + 1013904223u;
+        f[i] = (uint8_t)(x >> 24);
+    }
+    f[0] = 0xFF;
+    f[1] = 0xD8;
+    f[n - 2] = 0xFF;
+    f[n - 1] = 0xD9;
+    return f;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return !out.empty();
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: cam_fifo_bench [--spi-call-us US] [--write-us US] [--link-kbps KBPS] [frame ...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    double writeUs = 300;    // one AT command over the bridge to the ESP32-S3
+    double linkKBps = 200;   // WiFi payload rate once the command is queued
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string a = argv[i];
+        if (a == "--spi-call-us" && i + 1 < argc)
+            SPI.callOverheadUs = atof(argv[++i]);
+        else if (a == "--write-us" && i + 1 < argc)
+            writeUs = atof(argv[++i]);
+        else if (a == "--link-kbps" && i + 1 < argc)
+            linkKBps = atof(argv[++i]);
+        else if (a.size() > 1 && a[0] == '-')
+        {
+            usage();
+            return 2;
+        }
+        else
+            files.push_back(a);
+    }
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> frames;
+    if (files.empty())
+    {
+        for (size_t kib : {8, 24, 64})
+            frames.push_back({std::to_string(kib) + " KiB synthetic", syntheticFrame(kib * 1024)});
+    }
+    for (const std::string &path : files)
+    {
+        std::vector<uint8_t> data;
+        if (!readFile(path.c_str(), data))
+        {
+            fprintf(stderr, "cannot read %s\n", path.c_str());
+            return 1;
+        }
+        frames.push_back({path, data});
+    }
+
+    printf("model: SPI call %.1f us, client write %.0f us + %.0f KB/s\n", SPI.callOverheadUs, writeUs, linkKBps);
+    printf("%-20s %-9s %9s %7s %9s %9s %8s  %s\n", "frame", "read-out", "SPI calls", "writes", "SPI ms", "total ms",
+           "KB/s", "data");
+    bool ok = true;
+    for (const auto &frame : frames)
+    {
+        for (bool burst : {false, true})
+        {
+            Result r = run(frame.second, burst, writeUs, linkKBps * 1024);
+            ok = ok && r.same;
+            double kbps = r.totalUs > 0 ? frame.second.size() / 1.024 / r.totalUs * 1000 : 0;
+            printf("%-20s %-9s %9llu %7u %9.1f %9.1f %8.1f  %s\n", frame.first.c_str(), burst ? "burst" : "per-byte",
+                   (unsigned long long)r.spiCalls, r.writes, r.spiUs / 1000, r.totalUs / 1000, kbps,
+                   r.same ? "ok" : "MISMATCH");
+        }
+    }
+    for (size_t size : {(size_t)300, (size_t)CAM_BURST_CHUNK, (size_t)CAM_BURST_CHUNK * 3 + 10})
+    {
+        bool rejected = finalBlockRejected(size);
+        ok = ok && rejected;
+        printf("final block of %zu bytes rejected -> incomplete: %s\n", size, rejected ? "ok" : "FAILED");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/**
+ * @file frame_receiver.cpp
+ * @brief Receive serial_frame.h camera frames on Linux.
+ *
+ * Reads the binary stream sent by arducam_capture_minute.ino and
+ * arducam_stream_minimal.ino from a serial port (configured raw at
+ * 921600 baud) or from a recorded file, verifies each frame's CRC-32, and
+ * writes the JPEG payloads to a directory and/or appends them to a
+ * timelapse archive (timelapse_archive.h).
+ *
+ * Bytes are read straight into a MirrorRing and each payload is written
+ * out from the ring, even when it wraps, so frames are never copied in
+ * user space. After a bad header or CRC the parser skips one byte and
+ * searches for the next magic, which also skips the sketches' text lines.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o frame_receiver tools/frame_receiver.cpp
+ *
+ * Usage:
+ *   frame_receiver /dev/ttyACM0 --out frames/
+ *   frame_receiver /dev/ttyACM0 --archive season2026
+ *   frame_receiver capture.bin --out frames/
+ *   frame_receiver capture.bin --bench 20
+ *
+ * A recording can be made with: stty -F /dev/ttyACM0 921600 raw && cat /dev/ttyACM0 > capture.bin
+ */
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serial_frame.h"
+#include "mirror_ring.h"
+#include "timelapse_archive.h"
+
+/** Payload bytes per second of a 921600 baud 8N1 link (10 bits per byte). */
+static const double LINK_BYTES_PER_SEC = 921600.0 / 10.0;
+
+struct ReceiverStats
+{
+    uint64_t frames = 0;
+    uint64_t payloadBytes = 0;
+    uint64_t crcErrors = 0;
+    uint64_t badHeaders = 0;
+    uint64_t skippedBytes = 0; ///< Bytes outside valid frames (text, noise, resync)
+    uint64_t seqGaps = 0;      ///< Frames missing according to the sequence numbers
+};
+
+class FrameParser
+{
+public:
+    /** `outDir` may be empty and `archive` null to only verify frames. */
+    FrameParser(std::string outDir, TimelapseWriter *archive) : _outDir(std::move(outDir)), _archive(archive) {}
+
+    /** Note the arrival time (Unix ms) of the bytes about to be parsed; archived frames carry it. */
+    void setTime(uint64_t nowMs) { _nowMs = nowMs; }
+
+    /** Parse as many complete frames as the ring holds; leaves partial data in place. */
+    void parse(MirrorRing &ring)
+    {
+        while (ring.used() >= SERIAL_FRAME_HEADER_SIZE)
+        {
+            const uint8_t *p = ring.readPtr();
+            size_t avail = ring.used();
+
+            if (memcmp(p, SERIAL_FRAME_MAGIC, 4) != 0)
+            {
+                skip(ring, findMagic(p, avail));
+                continue;
+            }
+
+            SerialFrameHeader h;
+            if (!serialFrameDecode(p, h))
+            {
+                _stats.badHeaders++;
+                skip(ring, 1);
+                continue;
+            }
+            if (avail < SERIAL_FRAME_HEADER_SIZE + h.length)
+                return; // wait for the rest of the payload
+
+            const uint8_t *payload = p + SERIAL_FRAME_HEADER_SIZE;
+            if (crc32Update(0, payload, h.length) != h.crc)
+            {
+                _stats.crcErrors++;
+                skip(ring, 1);
+                continue;
+            }
+
+            deliver(h, payload);
+            ring.consume(SERIAL_FRAME_HEADER_SIZE + h.length);
+        }
+    }
+
+    const ReceiverStats &stats() const { return _stats; }
+
+private:
+    /** Offset of the next possible magic in `p`, keeping a partial magic at the end. */
+    static size_t findMagic(const uint8_t *p, size_t n)
+    {
+        for (size_t i = 1; i < n; ++i)
+        {
+            const uint8_t *q = (const uint8_t *)memchr(p + i, SERIAL_FRAME_MAGIC[0], n - i);
+            if (!q)
+                break;
+            i = q - p;
+            size_t m = n - i < 4 ? n - i : 4;
+            if (memcmp(q, SERIAL_FRAME_MAGIC, m) == 0)
+                return i;
+        }
+        return n;
+    }
+
+    void skip(MirrorRing &ring, size_t n)
+    {
+        _stats.skippedBytes += n;
+        ring.consume(n);
+    }
+
+    void deliver(const SerialFrameHeader &h, const uint8_t *payload)
+    {
+        if (_haveSeq && h.seq != _lastSeq + 1 && h.seq > _lastSeq)
+            _stats.seqGaps += h.seq - _lastSeq - 1;
+        _haveSeq = true;
+        _lastSeq = h.seq;
+        _stats.frames++;
+        _stats.payloadBytes += h.length;
+
+        if (_archive)
+            _archive->append(_nowMs, payload, h.length, h.seq, h.timestamp, h.crc);
+        if (_outDir.empty())
+            return;
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%08u.jpg", h.seq);
+        std::string path = _outDir + name;
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            perror(path.c_str());
+            return;
+        }
+        // Written directly from the ring; the mirror mapping makes a wrapped frame contiguous.
+        size_t off = 0;
+        while (off < h.length)
+        {
+            ssize_t w = write(fd, payload + off, h.length - off);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+            {
+                perror(path.c_str());
+                break;
+            }
+            off += (size_t)w;
+        }
+        close(fd);
+    }
+
+    std::string _outDir;
+    TimelapseWriter *_archive;
+    uint64_t _nowMs = 0;
+    ReceiverStats _stats;
+    bool _haveSeq = false;
+    uint32_t _lastSeq = 0;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) { stopRequested = 1; }
+
+/** Put a tty into raw 8N1 mode at 921600 baud. Not an error for regular files. */
+static bool configureSerial(int fd)
+{
+    if (!isatty(fd))
+        return true;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B921600);
+    cfsetospeed(&tio, B921600);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+/** Read `fd` to EOF (or until interrupted) through the ring. Returns bytes read. */
+static uint64_t pump(int fd, MirrorRing &ring, FrameParser &parser)
+{
+    uint64_t total = 0;
+    while (!stopRequested)
+    {
+        ssize_t n = read(fd, ring.writePtr(), ring.space());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        parser.setTime((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        ring.produce((size_t)n);
+        total += (uint64_t)n;
+        parser.parse(ring);
+    }
+    return total;
+}
+
+static void printStats(const ReceiverStats &s)
+{
+    fprintf(stderr,
+            "frames %llu, payload %llu bytes, crc errors %llu, bad headers %llu, skipped %llu bytes, seq gaps %llu\n",
+            (unsigned long long)s.frames, (unsigned long long)s.payloadBytes, (unsigned long long)s.crcErrors,
+            (unsigned long long)s.badHeaders, (unsigned long long)s.skippedBytes, (unsigned long long)s.seqGaps);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s <tty|file> [--out DIR] [--archive BASE] [--bench N]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    std::string outDir;
+    const char *archivePath = nullptr;
+    int benchRuns = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            outDir = argv[++i];
+        else if (!strcmp(argv[i], "--archive") && i + 1 < argc)
+            archivePath = argv[++i];
+        else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+            benchRuns = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !input)
+            input = argv[i];
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!input)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = open(input, O_RDONLY | O_NOCTTY);
+    if (fd < 0 || !configureSerial(fd))
+    {
+        perror(input);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    // Room for the largest frame plus the next header, so a frame is always parseable in place.
+    MirrorRing ring(2 * (SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_MAX_PAYLOAD));
+    std::unique_ptr<TimelapseWriter> archive;
+    try
+    {
+        if (archivePath)
+            archive.reset(new TimelapseWriter(archivePath));
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    FrameParser parser(outDir, archive.get());
+
+    if (benchRuns <= 0)
+    {
+        pump(fd, ring, parser);
+        printStats(parser.stats());
+        close(fd);
+        return 0;
+    }
+
+    if (isatty(fd))
+    {
+        fprintf(stderr, "--bench needs a recorded file\n");
+        return 2;
+    }
+    uint64_t bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int run = 0; run < benchRuns && !stopRequested; ++run)
+    {
+        lseek(fd, 0, SEEK_SET);
+        ring.clear();
+        bytes += pump(fd, ring, parser);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    close(fd);
+
+    printStats(parser.stats());
+    double rate = secs > 0 ? bytes / secs : 0;
+    fprintf(stderr, "bench: %d runs, %llu bytes in %.3f s = %.1f MB/s (%.0fx a 921600 baud link)\n", benchRuns,
+            (unsigned long long)bytes, secs, rate / 1e6, rate / LINK_BYTES_PER_SEC);
+    return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file ArduCAM.h
+ * @brief Mocked ArduCAM for the host benches, backed by the SPI mock's FIFO.
+ *
+ * Captures complete at once and report the loaded FIFO length; rewinding
+ * the read pointer rewinds the SPI mock. Only what cam_fifo.h and
+ * camera_pipeline.h use is provided.
+ */
+#pragma once
+
+#include "Arduino.h"
+#include "SPI.h"
+
+#define OV2640 5
+#define ARDUCHIP_TEST1 0x00
+#define ARDUCHIP_FIFO 0x04
+#define FIFO_CLEAR_MASK 0x01
+#define FIFO_RDPTR_RST_MASK 0x10
+#define ARDUCHIP_TRIG 0x41
+#define CAP_DONE_MASK 0x08
+
+class ArduCAM
+{
+public:
+    ArduCAM(byte model, int cs) {}
+
+    void CS_LOW() {}
+    void CS_HIGH() {}
+    void set_fifo_burst() {}
+    void flush_fifo() {}
+    void clear_fifo_flag() {}
+    void start_capture() {}
+
+    void write_reg(uint8_t addr, uint8_t value)
+    {
+        if (addr == ARDUCHIP_FIFO && (value & FIFO_RDPTR_RST_MASK))
+            SPI.rewind();
+    }
+    uint8_t read_reg(uint8_t addr) { return 0; }
+    uint8_t get_bit(uint8_t addr, uint8_t bit) { return addr == ARDUCHIP_TRIG ? bit & CAP_DONE_MASK : 0; }
+
+    /** FIFO length reported by the camera (what the SPI mock serves). */
+    uint32_t fifoLength = 0;
+    uint32_t read_fifo_length() { return fifoLength; }
+};
@@ -0,0 +1,100 @@
+/**
+ * @file Arduino.h
+ * @brief Just enough of the Arduino core to build firmware headers on a host.
+ *
+ * Used by the benches in tools/ (build with `-Itools/host -Isrc`):
+ *   - Print with the ArduinoCore-API write granularity: strings and
+ *     integers are one write each, `println()` adds a write for the CRLF
+ *     and floats are written a digit at a time
+ *   - `millis()`, `micros()` and the delays on a simulated clock that the
+ *     mocks advance by the modelled cost of each call (`hostAdvance()`),
+ *     so timings measured by the firmware code are the modelled ones
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+/** Simulated time in microseconds. */
+inline double &hostClockUs()
+{
+    static double us = 0;
+    return us;
+}
+
+inline void hostAdvance(double us) { hostClockUs() += us; }
+
+inline unsigned long micros() { return (unsigned long)hostClockUs(); }
+inline unsigned long millis() { return (unsigned long)(hostClockUs() / 1000); }
+inline void delayMicroseconds(unsigned int us) { hostAdvance(us); }
+inline void delay(unsigned long ms) { hostAdvance(ms * 1000.0); }
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n)
+    {
+        size_t k = 0;
+        while (n--)
+            k += write(*buf++);
+        return k;
+    }
+    size_t write(const char *s) { return s ? write((const uint8_t *)s, strlen(s)) : 0; }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return print((long)v); }
+    size_t print(unsigned v) { return print((unsigned long)v); }
+    size_t print(long v)
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%ld", v);
+        return write(buf);
+    }
+    size_t print(unsigned long v)
+    {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%lu", v);
+        return write(buf);
+    }
+    size_t print(double v, int digits = 2)
+    {
+        // Print::printFloat(): sign, integer part, '.', then one write per digit.
+        size_t n = 0;
+        if (v < 0)
+        {
+            n += print('-');
+            v = -v;
+        }
+        double rounding = 0.5;
+        for (int i = 0; i < digits; ++i)
+            rounding /= 10.0;
+        v += rounding;
+        unsigned long whole = (unsigned long)v;
+        double rest = v - (double)whole;
+        n += print(whole);
+        if (digits > 0)
+            n += print('.');
+        while (digits-- > 0)
+        {
+            rest *= 10.0;
+            unsigned digit = (unsigned)rest;
+            n += print(digit);
+            rest -= digit;
+        }
+        return n;
+    }
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T v)
+    {
+        size_t n = print(v);
+        return n + println();
+    }
+};
@@ -0,0 +1,85 @@
+/**
+ * @file SPI.h
+ * @brief Mocked SPI bus for the host benches: serves a recorded ArduCAM FIFO.
+ *
+ * Every transfer returns the next FIFO byte and advances the simulated
+ * clock (Arduino.h) by a per-call overhead plus the bit time of the bytes
+ * moved, so per-byte and buffer transfers can be compared. The costs are
+ * parameters of the model, not measurements; set them from a scope trace.
+ */
+#pragma once
+
+#include "Arduino.h"
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+struct SPISettings
+{
+    SPISettings(uint32_t clock, uint8_t order, uint8_t mode) : clock(clock) {}
+    uint32_t clock;
+};
+
+class SPIClass
+{
+public:
+    /** Modelled cost of one `transfer()` call besides the bits on the wire (us). */
+    double callOverheadUs = 1.5;
+    /** Calls and bytes since the last `resetCounters()`. */
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    double busyUs = 0; ///< Modelled time spent in transfers
+
+    /** Serve `n` bytes of `data` as the FIFO contents. */
+    void load(const uint8_t *data, size_t n)
+    {
+        _fifo = data;
+        _length = n;
+        _pos = 0;
+    }
+    void rewind() { _pos = 0; }
+    void resetCounters()
+    {
+        calls = bytes = 0;
+        busyUs = 0;
+    }
+
+    void begin() {}
+    void beginTransaction(SPISettings settings) { _clock = settings.clock; }
+    /** Outside a transaction the bus runs at the core's default clock. */
+    void endTransaction() { _clock = DEFAULT_CLOCK; }
+
+    uint8_t transfer(uint8_t)
+    {
+        cost(1);
+        return next();
+    }
+
+    void transfer(void *buf, size_t n)
+    {
+        cost(n);
+        uint8_t *p = (uint8_t *)buf;
+        while (n--)
+            *p++ = next();
+    }
+
+private:
+    void cost(size_t n)
+    {
+        calls++;
+        bytes += n;
+        double us = callOverheadUs + n * 8e6 / _clock;
+        busyUs += us;
+        hostAdvance(us);
+    }
+
+    uint8_t next() { return _pos < _length ? _fifo[_pos++] : 0; }
+
+    const uint8_t *_fifo = nullptr;
+    size_t _length = 0;
+    size_t _pos = 0;
+    static const uint32_t DEFAULT_CLOCK = 4000000;
+    uint32_t _clock = DEFAULT_CLOCK;
+};
+
+inline SPIClass SPI;
@@ -0,0 +1,274 @@
+/**
+ * @file http_response_bench.cpp
+ * @brief Count client writes per HTTP response: piecewise printing vs HttpResponse.
+ *
+ * On the UNO R4 WiFi each `WiFiClient::write()` is one command over the
+ * serial AT bridge to the ESP32-S3 and usually one TCP segment, so the
+ * number of writes per response is what the handlers cost on the wire.
+ *
+ * The bench replays the HTTP firmware's responses with representative
+ * values against a mocked client that counts `write()` calls and bytes:
+ * once as the handlers used to print them (a `print`/`println` per header
+ * and JSON fragment), once through `src/http_response.h`. The Print in
+ * tools/host/Arduino.h follows ArduinoCore-API: strings and integers are one
+ * write each, `println()` adds a write for the CRLF and floats are written a
+ * digit at a time.
+ *
+ * It checks that both variants send the same body, and that a body or head
+ * too big for the buffer becomes a 500 in one write, and reports writes,
+ * bytes and the estimated wire bytes with 40 bytes of TCP/IP header per
+ * write.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Itools/host -Isrc -o http_response_bench tools/http_response_bench.cpp
+ *
+ * Usage:
+ *   http_response_bench
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <Arduino.h>
+#include "http_response.h"
+
+/** Mocked WiFiClient: counts write() calls and keeps what was sent. */
+class CountingClient : public Print
+{
+public:
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t n) override
+    {
+        writes++;
+        data.append((const char *)buf, n);
+        return n;
+    }
+    using Print::write;
+
+    /** Everything after the blank line that ends the head. */
+    std::string body() const
+    {
+        size_t at = data.find("\r\n\r\n");
+        return at == std::string::npos ? std::string() : data.substr(at + 4);
+    }
+
+    unsigned writes = 0;
+    std::string data;
+};
+
+// Representative values for the firmware's globals.
+static const char *IP = "192.168.1.42";
+static const float TEMP = 23.4f;
+static const float HUM = 51.0f;
+static const int LEVEL = 64;
+static const char *CANOPY = "{\"cover\":37.5,\"exg\":0.08,\"age\":42,\"hist\":[0,3,51,289,402,170,61,19,4,1,0,0]}";
+
+void printStatusJson(Print &out)
+{
+    out.print("{\"connected\":");
+    out.print("true");
+    out.print(",\"ip\":\"");
+    out.print(IP);
+    out.print("\",\"cameraDetected\":");
+    out.print("true");
+    out.print(",\"camera\":\"");
+    out.print("ok");
+    out.print("\",\"cameraOutages\":");
+    out.print(0UL);
+    out.print(",\"cameraRecoveries\":");
+    out.print(0UL);
+    out.print(",\"resolution\":\"");
+    out.print(320U);
+    out.print("x");
+    out.print(240U);
+    out.print("\"");
+    out.print(",\"framesDropped\":");
+    out.print(2UL);
+    out.print(",\"framesUnchanged\":");
+    out.print(118UL);
+    out.print(",\"loopStallIdleMs\":");
+    out.print(3UL);
+    out.print(",\"loopStallCaptureMs\":");
+    out.print(41UL);
+    out.print("}");
+}
+
+void printSensorJson(Print &out)
+{
+    out.print("{\"temperature\":");
+    out.print(TEMP, 1);
+    out.print(",\"humidity\":");
+    out.print(HUM, 0);
+    out.print(",\"level\":");
+    out.print(LEVEL);
+    out.print(",\"pump\":");
+    out.print("false");
+    out.print(",\"warning\":");
+    out.print("null");
+    out.print(",\"canopy\":");
+    out.print(CANOPY);
+    out.print("}");
+}
+
+void printTimeJson(Print &out)
+{
+    out.print("{\"datetime\":\"");
+    out.print("16/10/2026 14:05");
+    out.print("\"}");
+}
+
+/** The head every JSON handler printed before its body. */
+void jsonHeadPiecewise(Print &client)
+{
+    client.println("HTTP/1.1 200 OK");
+    client.println("Content-Type: application/json");
+    client.println("Connection: close");
+    client.println();
+}
+
+struct Case
+{
+    const char *name;
+    void (*piecewise)(Print &);
+    void (*buffered)(Print &);
+};
+
+static const Case CASES[] = {
+    {"/status",
+     [](Print &c) {
+         jsonHeadPiecewise(c);
+         printStatusJson(c);
+     },
+     [](Print &c) {
+         HttpResponse<384> res;
+         printStatusJson(res);
+         res.send(c, 200, "OK", "application/json");
+     }},
+    {"/sensor",
+     [](Print &c) {
+         jsonHeadPiecewise(c);
+         printSensorJson(c);
+     },
+     [](Print &c) {
+         HttpResponse<320> res;
+         printSensorJson(res);
+         res.send(c, 200, "OK", "application/json");
+     }},
+    {"/time",
+     [](Print &c) {
+         jsonHeadPiecewise(c);
+         printTimeJson(c);
+     },
+     [](Print &c) {
+         HttpResponse<48> res;
+         printTimeJson(res);
+         res.send(c, 200, "OK", "application/json");
+     }},
+    {"/image 204",
+     [](Print &c) {
+         c.println("HTTP/1.1 204 No Content");
+         c.println("Connection: close");
+         c.println();
+     },
+     [](Print &c) {
+         HttpResponse<0> res;
+         res.send(c, 204, "No Content");
+     }},
+    {"/image 304",
+     [](Print &c) {
+         c.println("HTTP/1.1 304 Not Modified");
+         c.print("ETag: ");
+         c.println("W/\"118\"");
+         c.println("Cache-Control: no-cache");
+         c.println("Connection: close");
+         c.println();
+     },
+     [](Print &c) {
+         HttpResponse<0> res;
+         res.send(c, 304, "Not Modified", nullptr, "ETag: W/\"118\"\r\nCache-Control: no-cache\r\n");
+     }},
+    {"/image 413",
+     [](Print &c) {
+         c.println("HTTP/1.1 413 Payload Too Large");
+         c.println("Content-Type: text/plain; charset=utf-8");
+         c.println("Connection: close");
+         c.println();
+         c.println("Captured image too large");
+     },
+     [](Print &c) {
+         HttpResponse<32> res;
+         res.println("Captured image too large");
+         res.send(c, 413, "Payload Too Large", "text/plain; charset=utf-8");
+     }},
+    {"/image 503",
+     [](Print &c) {
+         c.println("HTTP/1.1 503 Service Unavailable");
+         c.println("Content-Type: text/plain; charset=utf-8");
+         c.println("Connection: close");
+         c.println();
+         c.println("Camera disabled on device");
+     },
+     [](Print &c) {
+         HttpResponse<32> res;
+         res.println("Camera disabled on device");
+         res.send(c, 503, "Service Unavailable", "text/plain; charset=utf-8");
+     }},
+};
+
+/** Estimated TCP/IP header bytes per segment (IPv4 + TCP without options). */
+static const unsigned SEGMENT_OVERHEAD = 40;
+
+int main()
+{
+    printf("%-12s %16s %16s %18s  %s\n", "response", "writes", "bytes", "wire bytes", "body");
+    printf("%-12s %7s %8s %7s %8s %8s %9s\n", "", "before", "after", "before", "after", "before", "after");
+    unsigned totalBefore = 0;
+    unsigned totalAfter = 0;
+    bool ok = true;
+    for (const Case &c : CASES)
+    {
+        CountingClient before;
+        CountingClient after;
+        c.piecewise(before);
+        c.buffered(after);
+        bool same = before.body() == after.body();
+        ok = ok && same && after.writes == 1;
+        unsigned wireBefore = before.data.size() + before.writes * SEGMENT_OVERHEAD;
+        unsigned wireAfter = after.data.size() + after.writes * SEGMENT_OVERHEAD;
+        totalBefore += before.writes;
+        totalAfter += after.writes;
+        printf("%-12s %7u %8u %7zu %8zu %8u %9u  %s\n", c.name, before.writes, after.writes, before.data.size(),
+               after.data.size(), wireBefore, wireAfter, same ? "same" : "DIFFERS");
+    }
+    printf("%-12s %7u %8u\n", "total", totalBefore, totalAfter);
+
+    // The builder's own edge cases.
+    CountingClient overflow;
+    HttpResponse<8> small;
+    small.print("more than eight bytes");
+    small.send(overflow, 200, "OK", "text/plain");
+    bool overflowOk = overflow.data.rfind("HTTP/1.1 500 ", 0) == 0 && overflow.body().empty() && overflow.writes == 1;
+    printf("overflow -> empty 500: %s\n", overflowOk ? "ok" : "FAILED");
+
+    CountingClient longHead;
+    std::string headers = "X-Filler: " + std::string(HTTP_HEAD_ROOM, 'x') + "\r\n";
+    HttpResponse<16> fine;
+    fine.print("ok");
+    httpKeepAlive() = true;
+    fine.send(longHead, 200, "OK", "text/plain", headers.c_str());
+    bool headOk = longHead.data.rfind("HTTP/1.1 500 ", 0) == 0 &&
+                  longHead.data.find("Connection: close\r\n\r\n") != std::string::npos && longHead.body().empty() &&
+                  longHead.writes == 1 && !httpKeepAlive();
+    printf("head overflow -> 500, close: %s\n", headOk ? "ok" : "FAILED");
+
+    CountingClient length;
+    HttpResponse<64> body;
+    body.print("{\"ok\":true}");
+    body.send(length, 200, "OK", "application/json");
+    bool lengthOk = length.data.find("Content-Length: 11\r\n") != std::string::npos && length.body() == "{\"ok\":true}";
+    printf("Content-Length matches body: %s\n", lengthOk ? "ok" : "FAILED");
+
+    return ok && overflowOk && headOk && lengthOk ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file jpeg_framer_bench.cpp
+ * @brief Check and time src/jpeg_framer.h over JPEGs and recorded FIFO dumps.
+ *
+ * Each input is framed the way CameraPipeline feeds it, in blocks of
+ * several sizes (1 byte, an odd size, CAM_BURST_CHUNK and all at once), so
+ * SOI and EOI markers straddle block boundaries. The result is compared
+ * with a plain search of the whole buffer.
+ *
+ * A clean JPEG (starting with SOI) is also wrapped the way the FIFO holds
+ * it: leading junk of 0, 1 and 8 bytes (older ArduChip revisions add a
+ * dummy byte), trailing padding up to the next 4 KiB, and the bench checks
+ * that the framer reports exactly the original JPEG. Two broken variants
+ * are checked too: the frame cut before EOI (truncated) and SOI pushed
+ * past SOI_SEARCH_LIMIT (no SOI). A file that does not start with SOI is
+ * taken as a raw FIFO dump and only compared with the plain search.
+ *
+ * Throughput is the host rate of `feed()` over CAM_BURST_CHUNK blocks; the
+ * framer runs the same code on the board, where the SPI read dominates.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o jpeg_framer_bench tools/jpeg_framer_bench.cpp
+ *
+ * Usage:
+ *   jpeg_framer_bench                       # synthetic frames
+ *   jpeg_framer_bench frame.jpg fifo.bin    # recorded frames or FIFO dumps
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "jpeg_framer.h"
+
+/** Block size CameraPipeline reads per SPI transfer (cam_fifo.h). */
+static const size_t BURST_CHUNK = 512;
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Expected
+{
+    bool valid;
+    bool truncated; ///< SOI found, no EOI
+    uint32_t start;
+    uint32_t length;
+};
+
+/** What the framer should report, by searching the whole buffer. */
+static Expected reference(const Bytes &data)
+{
+    Expected e = {false, false, 0, 0};
+    size_t soi = 0;
+    for (size_t i = 1; i < data.size() && i < JpegFramer::SOI_SEARCH_LIMIT; ++i)
+    {
+        if (data[i - 1] == 0xFF && data[i] == 0xD8)
+        {
+            soi = i;
+            break;
+        }
+    }
+    if (soi == 0)
+        return e;
+    for (size_t i = soi + 2; i < data.size(); ++i)
+    {
+        if (data[i - 1] == 0xFF && data[i] == 0xD9)
+        {
+            e.valid = true;
+            e.start = soi - 1;
+            e.length = i + 1 - e.start;
+            return e;
+        }
+    }
+    e.truncated = true;
+    return e;
+}
+
+/** Frame `data` in blocks of `block` bytes, as CameraPipeline does. */
+static bool frameMatches(const Bytes &data, size_t block, const Expected &want)
+{
+    JpegFramer framer;
+    framer.begin();
+    for (size_t at = 0; at < data.size() && !framer.done(); at += block)
+        framer.feed(data.data() + at, (data.size() - at < block) ? data.size() - at : block);
+    bool valid = framer.end();
+    if (valid != want.valid)
+        return false;
+    if (!valid)
+        return (framer.stats().truncated == 1) == want.truncated;
+    return framer.start() == want.start && framer.length() == want.length;
+}
+
+/** A JPEG-shaped frame: SOI, stuffed pseudo-random entropy data, EOI. */
+static Bytes syntheticJpeg(size_t n, uint32_t seed)
+{
+    Bytes f = {0xFF, 0xD8};
+    uint32_t x = seed;
+    while (f.size() < n - 2)
+    {
+        x = x * 1664525u + 1013904223u;
+        uint8_t b = (uint8_t)(x >> 24);
+        f.push_back(b);
+        // Entropy-coded data never holds a marker: 0xFF is followed by 0x00.
+        if (b == 0xFF)
+            f.push_back(0x00);
+    }
+    f.push_back(0xFF);
+    f.push_back(0xD9);
+    return f;
+}
+
+/** The JPEG as a FIFO read-out: `lead` junk bytes before it, padding to the next 4 KiB after. */
+static Bytes asFifo(const Bytes &jpeg, size_t lead)
+{
+    Bytes fifo(lead, 0x00);
+    fifo.insert(fifo.end(), jpeg.begin(), jpeg.end());
+    size_t padded = (fifo.size() + 4095) / 4096 * 4096;
+    fifo.resize(padded, 0x00);
+    return fifo;
+}
+
+static bool readFile(const char *path, Bytes &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return !out.empty();
+}
+
+static unsigned checks = 0;
+static unsigned failures = 0;
+
+static void check(const std::string &name, const Bytes &data, const Expected &want)
+{
+    static const size_t BLOCKS[] = {1, 7, BURST_CHUNK, (size_t)-1};
+    for (size_t block : BLOCKS)
+    {
+        checks++;
+        if (!frameMatches(data, block == (size_t)-1 ? data.size() : block, want))
+        {
+            failures++;
+            printf("FAILED: %s, block %zu\n", name.c_str(), block == (size_t)-1 ? data.size() : block);
+        }
+    }
+}
+
+/** Host MB/s of feed() over `data` in CAM_BURST_CHUNK blocks, repeated for about 0.2 s. */
+static double throughput(const Bytes &data)
+{
+    JpegFramer framer;
+    uint64_t bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < 0.2)
+    {
+        for (int rep = 0; rep < 16; ++rep)
+        {
+            framer.begin();
+            for (size_t at = 0; at < data.size() && !framer.done(); at += BURST_CHUNK)
+            {
+                size_t n = (data.size() - at < BURST_CHUNK) ? data.size() - at : BURST_CHUNK;
+                framer.feed(data.data() + at, n);
+                bytes += n;
+            }
+            framer.end();
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    return bytes / elapsed / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::pair<std::string, Bytes>> inputs;
+    if (argc < 2)
+    {
+        for (size_t kib : {4, 24, 96})
+            inputs.push_back({std::to_string(kib) + " KiB synthetic", syntheticJpeg(kib * 1024, (uint32_t)kib)});
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        Bytes data;
+        if (!readFile(argv[i], data))
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        inputs.push_back({argv[i], data});
+    }
+
+    printf("%-28s %10s %8s %10s  %s\n", "input", "bytes", "start", "length", "MB/s (host)");
+    for (const auto &input : inputs)
+    {
+        const Bytes &data = input.second;
+        bool jpeg = data.size() >= 4 && data[0] == 0xFF && data[1] == 0xD8;
+        Bytes fifo = jpeg ? asFifo(data, 1) : data;
+        Expected found = reference(fifo);
+        check(input.first, fifo, found);
+        if (jpeg)
+        {
+            // The framer must give back exactly the JPEG, whatever surrounds it.
+            Expected exact = reference(data);
+            for (size_t lead : {0, 1, 8})
+            {
+                Expected want = {true, false, (uint32_t)lead, exact.length};
+                check(input.first + " lead " + std::to_string(lead), asFifo(data, lead), want);
+            }
+            Bytes cut(data.begin(), data.end() - 2);
+            check(input.first + " truncated", cut, {false, true, 0, 0});
+            Bytes late(JpegFramer::SOI_SEARCH_LIMIT, 0x00);
+            late.insert(late.end(), data.begin(), data.end());
+            check(input.first + " late SOI", late, {false, false, 0, 0});
+        }
+        printf("%-28s %10zu %8s %10s  %.0f\n", input.first.c_str(), fifo.size(),
+               found.valid ? std::to_string(found.start).c_str() : "-",
+               found.valid ? std::to_string(found.length).c_str() : (found.truncated ? "truncated" : "no SOI"),
+               throughput(fifo));
+    }
+    printf("%u checks, %u failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
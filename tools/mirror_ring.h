@@ -0,0 +1,80 @@
+/**
+ * @file mirror_ring.h
+ * @brief Linux byte ring buffer mapped twice back to back ("magic ring").
+ *
+ * The same memory is mapped at [base, base + size) and [base + size,
+ * base + 2 * size), so any span of up to `size` bytes starting anywhere in
+ * the ring is contiguous in memory. Parsers can run memchr()/CRC over a
+ * frame that wraps around the end, and write() it out, without copying it
+ * into a scratch buffer first.
+ *
+ * Usage:
+ *   MirrorRing ring(1 << 20);
+ *   ssize_t n = read(fd, ring.writePtr(), ring.space()); ring.produce(n);
+ *   parse ring.readPtr() .. ring.readPtr() + ring.used(); ring.consume(k);
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+class MirrorRing
+{
+public:
+    /** `size` is rounded up to a whole number of pages. */
+    explicit MirrorRing(size_t size)
+    {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        _size = (size + page - 1) / page * page;
+
+        int fd = memfd_create("mirror_ring", MFD_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("memfd_create failed");
+        if (ftruncate(fd, (off_t)_size) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("ftruncate failed");
+        }
+
+        // Reserve 2 * size of address space, then map the file into both halves.
+        void *base = mmap(nullptr, 2 * _size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        bool ok = base != MAP_FAILED &&
+                  mmap(base, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+                  mmap((uint8_t *)base + _size, _size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+        close(fd);
+        if (!ok)
+        {
+            if (base != MAP_FAILED)
+                munmap(base, 2 * _size);
+            throw std::runtime_error("mirror mmap failed");
+        }
+        _base = (uint8_t *)base;
+    }
+
+    ~MirrorRing() { munmap(_base, 2 * _size); }
+
+    MirrorRing(const MirrorRing &) = delete;
+    MirrorRing &operator=(const MirrorRing &) = delete;
+
+    size_t capacity() const { return _size; }
+    size_t used() const { return _head - _tail; }
+    size_t space() const { return _size - used(); }
+
+    /** Start of the unread data; `used()` bytes are contiguous from here. */
+    uint8_t *readPtr() const { return _base + (_tail % _size); }
+    /** Where new data goes; `space()` bytes are contiguous from here. */
+    uint8_t *writePtr() const { return _base + (_head % _size); }
+
+    void produce(size_t n) { _head += n; }
+    void consume(size_t n) { _tail += n; }
+    void clear() { _head = _tail = 0; }
+
+private:
+    uint8_t *_base = nullptr;
+    size_t _size = 0;
+    uint64_t _head = 0; ///< Total bytes produced
+    uint64_t _tail = 0; ///< Total bytes consumed
+};
@@ -0,0 +1,329 @@
+/**
+ * @file mqtt_reassembler.cpp
+ * @brief Rebuild camera frames published in fragments by the MQTT firmware.
+ *
+ * `iot-agriculture-mqtt.ino` publishes each JPEG as a JSON manifest on
+ * `<base>/image/<seq>/manifest` and fragments on `<base>/image/<seq>/<n>`.
+ * This tool reads a message log, reassembles frames per device, checks the
+ * size and CRC-32 from the manifest, optionally writes the JPEGs, and
+ * reports fragment loss, missing frames and latency.
+ *
+ * The log is one message per line in the format written by
+ *   mosquitto_sub -h <broker> -t 'iot/agriculture/+/image/#' -F '%U %t %x'
+ * i.e. "<unix time with fraction> <topic> <payload as hex>" (adjust the
+ * prefix if SECRET_MQTT_BASETOPIC is not `iot/agriculture`). Reading from
+ * "-" processes a live pipe.
+ *
+ * A frame is judged when all its fragments have arrived, when a newer
+ * manifest from the same device arrives, or at the end of the log. The
+ * sequence number restarts when a device reboots, so a manifest numbered
+ * below the last one starts a new session instead of counting as a gap.
+ * Latency is measured from the manifest's NTP capture time (1 s resolution)
+ * and, more precisely, from the manifest's arrival to the last fragment's.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o mqtt_reassembler tools/mqtt_reassembler.cpp
+ *
+ * Usage:
+ *   mosquitto_sub -h broker -t 'iot/agriculture/+/image/#' -F '%U %t %x' > images.log
+ *   mqtt_reassembler images.log --out frames/
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+
+struct Manifest
+{
+    uint32_t seq = 0;
+    uint32_t size = 0;
+    uint32_t fragments = 0;
+    uint32_t crc = 0;
+    double epoch = 0;
+};
+
+struct PendingFrame
+{
+    bool haveManifest = false;
+    Manifest manifest;
+    double manifestAt = 0;
+    double lastAt = 0;
+    std::map<uint32_t, std::string> fragments;
+};
+
+struct DeviceState
+{
+    bool haveSeq = false;
+    uint32_t lastSeq = 0; ///< Highest manifest sequence number seen
+    std::map<uint32_t, PendingFrame> pending;
+};
+
+struct ReassemblyStats
+{
+    uint64_t complete = 0;
+    uint64_t incomplete = 0;   ///< Judged with fragments missing
+    uint64_t corrupt = 0;      ///< All fragments present but size or CRC wrong
+    uint64_t noManifest = 0;   ///< Fragments whose manifest never arrived
+    uint64_t missingSeq = 0;   ///< Sequence numbers with no message at all
+    uint64_t restarts = 0;     ///< Sequence numbers going backwards (device rebooted)
+    uint64_t fragmentsExpected = 0;
+    uint64_t fragmentsReceived = 0;
+    std::vector<double> transferMs; ///< Manifest arrival to last fragment
+    std::vector<double> latencyMs;  ///< Capture (NTP) to last fragment
+};
+
+class Reassembler
+{
+public:
+    explicit Reassembler(std::string outDir) : _outDir(std::move(outDir)) {}
+
+    /** Process one log line. Returns false when the line is malformed. */
+    bool line(const std::string &text)
+    {
+        size_t sp1 = text.find(' ');
+        size_t sp2 = sp1 == std::string::npos ? sp1 : text.find(' ', sp1 + 1);
+        if (sp2 == std::string::npos)
+            return false;
+        double at = strtod(text.c_str(), nullptr);
+        std::string topic = text.substr(sp1 + 1, sp2 - sp1 - 1);
+        std::string payload;
+        if (!unhex(text.c_str() + sp2 + 1, payload))
+            return false;
+
+        size_t img = topic.rfind("/image/");
+        if (img == std::string::npos)
+            return true; // not an image message
+        std::string device = topic.substr(0, img);
+        std::string rest = topic.substr(img + 7);
+        size_t slash = rest.find('/');
+        if (slash == std::string::npos)
+            return false;
+        uint32_t seq = strtoul(rest.c_str(), nullptr, 10);
+        std::string leaf = rest.substr(slash + 1);
+
+        DeviceState &dev = _devices[device];
+        if (leaf == "manifest" && dev.haveSeq && seq < dev.lastSeq)
+        {
+            // The device rebooted: judge the old session's frames and count afresh.
+            for (auto &old : dev.pending)
+                finish(device, old.first, old.second);
+            dev.pending.clear();
+            dev.haveSeq = false;
+            _stats.restarts++;
+        }
+        PendingFrame &frame = dev.pending[seq];
+        frame.lastAt = at;
+        if (leaf == "manifest")
+        {
+            frame.haveManifest = parseManifest(payload, frame.manifest);
+            frame.manifestAt = at;
+            if (dev.haveSeq && seq > dev.lastSeq + 1)
+                _stats.missingSeq += seq - dev.lastSeq - 1;
+            if (!dev.haveSeq || seq > dev.lastSeq)
+                dev.lastSeq = seq;
+            dev.haveSeq = true;
+            // A newer manifest means the device has moved on: judge older frames now.
+            for (auto it = dev.pending.begin(); it != dev.pending.end() && it->first < seq;)
+            {
+                finish(device, it->first, it->second);
+                it = dev.pending.erase(it);
+            }
+        }
+        else
+        {
+            frame.fragments[strtoul(leaf.c_str(), nullptr, 10)] = std::move(payload);
+        }
+
+        if (frame.haveManifest && frame.fragments.size() >= frame.manifest.fragments)
+        {
+            finish(device, seq, frame);
+            dev.pending.erase(seq);
+        }
+        return true;
+    }
+
+    /** Judge every frame still pending (end of log). */
+    void flush()
+    {
+        for (auto &dev : _devices)
+        {
+            for (auto &p : dev.second.pending)
+                finish(dev.first, p.first, p.second);
+            dev.second.pending.clear();
+        }
+    }
+
+    const ReassemblyStats &stats() const { return _stats; }
+
+private:
+    static bool unhex(const char *s, std::string &out)
+    {
+        size_t n = strlen(s);
+        while (n && (s[n - 1] == '\r' || s[n - 1] == '\n'))
+            n--;
+        if (n % 2)
+            return false;
+        out.resize(n / 2);
+        for (size_t i = 0; i < n / 2; ++i)
+        {
+            char byte[3] = {s[2 * i], s[2 * i + 1], 0};
+            char *end;
+            out[i] = (char)strtoul(byte, &end, 16);
+            if (*end)
+                return false;
+        }
+        return true;
+    }
+
+    /** Fetch a numeric JSON field; the manifest is flat and written by the firmware. */
+    static bool field(const std::string &json, const char *key, double &value, int base = 10)
+    {
+        std::string k = std::string("\"") + key + "\":";
+        size_t at = json.find(k);
+        if (at == std::string::npos)
+            return false;
+        const char *p = json.c_str() + at + k.size();
+        if (*p == '"')
+            p++;
+        value = base == 10 ? strtod(p, nullptr) : (double)strtoul(p, nullptr, base);
+        return true;
+    }
+
+    static bool parseManifest(const std::string &json, Manifest &m)
+    {
+        double seq, size, fragments, crc, epoch = 0;
+        if (!field(json, "seq", seq) || !field(json, "size", size) || !field(json, "fragments", fragments) ||
+            !field(json, "crc", crc, 16))
+            return false;
+        field(json, "epoch", epoch);
+        m.seq = (uint32_t)seq;
+        m.size = (uint32_t)size;
+        m.fragments = (uint32_t)fragments;
+        m.crc = (uint32_t)crc;
+        m.epoch = epoch;
+        return true;
+    }
+
+    void finish(const std::string &device, uint32_t seq, PendingFrame &frame)
+    {
+        if (!frame.haveManifest)
+        {
+            _stats.noManifest++;
+            _stats.fragmentsReceived += frame.fragments.size();
+            return;
+        }
+        const Manifest &m = frame.manifest;
+        _stats.fragmentsExpected += m.fragments;
+        _stats.fragmentsReceived += std::min<size_t>(frame.fragments.size(), m.fragments);
+        if (frame.fragments.size() < m.fragments)
+        {
+            _stats.incomplete++;
+            fprintf(stderr, "%s seq %u: %zu of %u fragments\n", device.c_str(), seq, frame.fragments.size(),
+                    m.fragments);
+            return;
+        }
+
+        std::string jpeg;
+        jpeg.reserve(m.size);
+        for (auto &f : frame.fragments)
+            jpeg += f.second;
+        if (jpeg.size() != m.size || crc32Update(0, (const uint8_t *)jpeg.data(), jpeg.size()) != m.crc)
+        {
+            _stats.corrupt++;
+            fprintf(stderr, "%s seq %u: size or CRC mismatch\n", device.c_str(), seq);
+            return;
+        }
+
+        _stats.complete++;
+        _stats.transferMs.push_back((frame.lastAt - frame.manifestAt) * 1000.0);
+        if (m.epoch > 0)
+            _stats.latencyMs.push_back((frame.lastAt - m.epoch) * 1000.0);
+        if (!_outDir.empty())
+        {
+            std::string name = device.substr(device.rfind('/') + 1);
+            std::string path = _outDir + "/" + name + "_" + std::to_string(seq) + ".jpg";
+            std::ofstream(path, std::ios::binary).write(jpeg.data(), jpeg.size());
+        }
+    }
+
+    std::string _outDir;
+    std::map<std::string, DeviceState> _devices;
+    ReassemblyStats _stats;
+};
+
+static void printLatency(const char *name, std::vector<double> v)
+{
+    if (v.empty())
+        return;
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (double x : v)
+        sum += x;
+    auto pct = [&v](double p) { return v[std::min(v.size() - 1, (size_t)(p * v.size()))]; };
+    fprintf(stderr, "%s ms: min %.0f, mean %.0f, p50 %.0f, p95 %.0f, max %.0f\n", name, v.front(), sum / v.size(),
+            pct(0.5), pct(0.95), v.back());
+}
+
+int main(int argc, char **argv)
+{
+    const char *input = nullptr;
+    std::string outDir;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            outDir = argv[++i];
+        else if (!input)
+            input = argv[i];
+        else
+        {
+            fprintf(stderr, "usage: %s <log|-> [--out DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!input)
+    {
+        fprintf(stderr, "usage: %s <log|-> [--out DIR]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream file;
+    if (strcmp(input, "-"))
+    {
+        file.open(input);
+        if (!file)
+        {
+            perror(input);
+            return 1;
+        }
+    }
+    std::istream &in = strcmp(input, "-") ? file : std::cin;
+
+    Reassembler reassembler(outDir);
+    std::string text;
+    uint64_t malformed = 0;
+    while (std::getline(in, text))
+        if (!text.empty() && !reassembler.line(text))
+            malformed++;
+    reassembler.flush();
+
+    const ReassemblyStats &s = reassembler.stats();
+    double loss = s.fragmentsExpected ? 100.0 * (s.fragmentsExpected - s.fragmentsReceived) / s.fragmentsExpected : 0;
+    fprintf(stderr,
+            "frames complete %llu, incomplete %llu, corrupt %llu, without manifest %llu, missing seq %llu, "
+            "restarts %llu\n"
+            "fragments %llu of %llu (%.2f%% lost), malformed lines %llu\n",
+            (unsigned long long)s.complete, (unsigned long long)s.incomplete, (unsigned long long)s.corrupt,
+            (unsigned long long)s.noManifest, (unsigned long long)s.missingSeq, (unsigned long long)s.restarts,
+            (unsigned long long)s.fragmentsReceived, (unsigned long long)s.fragmentsExpected, loss,
+            (unsigned long long)malformed);
+    printLatency("transfer (manifest to last fragment)", s.transferMs);
+    printLatency("latency (capture to last fragment)", s.latencyMs);
+    return 0;
+}
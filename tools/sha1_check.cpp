@@ -0,0 +1,115 @@
+/**
+ * @file sha1_check.cpp
+ * @brief Check src/sha1.h and src/base64.h against published test vectors.
+ *
+ * The WebSocket handshake in websocket.h is only as good as these two
+ * headers, and a wrong `Sec-WebSocket-Accept` just shows up as a browser
+ * refusing the socket. The check runs:
+ *   - the FIPS 180 SHA-1 examples: "abc", the empty message, the two-block
+ *     448-bit message and one million 'a' (fed in uneven pieces, so block
+ *     boundaries fall inside `update()` calls)
+ *   - the RFC 4648 Base64 examples ("", "f", "fo", ... "foobar")
+ *   - the RFC 6455 section 1.3 handshake: key "dGhlIHNhbXBsZSBub25jZQ=="
+ *     gives accept "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o sha1_check tools/sha1_check.cpp
+ *
+ * Usage:
+ *   sha1_check
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "base64.h"
+#include "sha1.h"
+
+static unsigned checks = 0;
+static unsigned failures = 0;
+
+static void check(const char *name, const std::string &got, const std::string &want)
+{
+    checks++;
+    if (got == want)
+        return;
+    failures++;
+    printf("FAILED: %s: got %s, want %s\n", name, got.c_str(), want.c_str());
+}
+
+static std::string hex(const uint8_t *data, size_t n)
+{
+    std::string out;
+    char byte[3];
+    for (size_t i = 0; i < n; ++i)
+    {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        out += byte;
+    }
+    return out;
+}
+
+/** SHA-1 of `data`, fed to `update()` in pieces of at most `piece` bytes. */
+static std::string sha1Hex(const std::string &data, size_t piece)
+{
+    Sha1 sha;
+    for (size_t at = 0; at < data.size(); at += piece)
+        sha.update((const uint8_t *)data.data() + at, data.size() - at < piece ? data.size() - at : piece);
+    uint8_t digest[Sha1::DIGEST_SIZE];
+    sha.final(digest);
+    return hex(digest, sizeof(digest));
+}
+
+static std::string base64(const std::string &data)
+{
+    std::string out(base64EncodedLength(data.size()) + 1, '\0');
+    size_t n = base64Encode((const uint8_t *)data.data(), data.size(), &out[0]);
+    out.resize(n);
+    return out;
+}
+
+/** `Sec-WebSocket-Accept` for `key`, computed as WebSocketHub::accept() does. */
+static std::string wsAccept(const std::string &key)
+{
+    static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    Sha1 sha;
+    sha.update((const uint8_t *)key.data(), key.size());
+    sha.update((const uint8_t *)GUID, sizeof(GUID) - 1);
+    uint8_t digest[Sha1::DIGEST_SIZE];
+    sha.final(digest);
+    char accept[32];
+    base64Encode(digest, sizeof(digest), accept);
+    return accept;
+}
+
+int main()
+{
+    static const struct
+    {
+        const char *name;
+        std::string data;
+        const char *digest;
+    } SHA1_VECTORS[] = {
+        {"sha1 \"abc\"", "abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+        {"sha1 \"\"", "", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+        {"sha1 448-bit", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+         "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+        {"sha1 million a", std::string(1000000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+    };
+    for (const auto &v : SHA1_VECTORS)
+        for (size_t piece : {(size_t)1, (size_t)63, (size_t)64, (size_t)1000})
+            check((std::string(v.name) + ", pieces of " + std::to_string(piece)).c_str(), sha1Hex(v.data, piece),
+                  v.digest);
+
+    static const char *const BASE64_VECTORS[][2] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"},
+    };
+    for (const auto &v : BASE64_VECTORS)
+        check((std::string("base64 \"") + v[0] + "\"").c_str(), base64(v[0]), v[1]);
+
+    check("RFC 6455 accept", wsAccept("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    printf("%u checks, %u failed\n", checks, failures);
+    return failures ? 1 : 0;
+}
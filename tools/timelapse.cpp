@@ -0,0 +1,178 @@
+/**
+ * @file timelapse.cpp
+ * @brief Inspect and extract frames from a timelapse archive (timelapse_archive.h).
+ *
+ * Archives are written by `frame_receiver --archive <base>`, or built from
+ * existing JPEG files with `import`.
+ *
+ * Build:
+ *   g++ -std=c++17 -O2 -Isrc -o timelapse tools/timelapse.cpp
+ *
+ * Usage:
+ *   timelapse info    <base>
+ *   timelapse list    <base> [FROM [TO]]
+ *   timelapse at      <base> TIME OUT.jpg      frame closest to TIME
+ *   timelapse extract <base> FROM TO DIR       frames in [FROM, TO)
+ *   timelapse import  <base> FILE.jpg...       append files, timed by mtime
+ *
+ * TIME is Unix seconds (fractions allowed) or UTC "YYYY-MM-DDTHH:MM:SS".
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+#include "timelapse_archive.h"
+
+/** Parse TIME into Unix ms. Returns false if it is neither form. */
+static bool parseTime(const char *s, uint64_t &ms)
+{
+    struct tm tm = {};
+    const char *end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end && *end == '\0')
+    {
+        ms = (uint64_t)timegm(&tm) * 1000;
+        return true;
+    }
+    char *e;
+    double secs = strtod(s, &e);
+    if (*e || secs < 0)
+        return false;
+    ms = (uint64_t)(secs * 1000.0);
+    return true;
+}
+
+static std::string formatTime(uint64_t ms)
+{
+    time_t t = (time_t)(ms / 1000);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char buf[40];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + n, sizeof(buf) - n, ".%03uZ", (unsigned)(ms % 1000));
+    return buf;
+}
+
+static bool writeFile(const std::string &path, const uint8_t *data, size_t n)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    timelapseWriteAll(fd, data, n);
+    close(fd);
+    return true;
+}
+
+static void printRecord(size_t i, const TimelapseRecord &r)
+{
+    printf("%zu %s seq=%u len=%u\n", i, formatTime(r.timeMs).c_str(), r.seq, r.length);
+}
+
+static int usage()
+{
+    fprintf(stderr, "usage: timelapse info|list|at|extract|import <base> ... (see timelapse.cpp)\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+        return usage();
+    std::string cmd = argv[1];
+    std::string base = argv[2];
+
+    try
+    {
+        if (cmd == "import")
+        {
+            // Oldest first, so the index stays in time order.
+            std::vector<std::pair<uint64_t, std::string>> files;
+            for (int i = 3; i < argc; ++i)
+            {
+                struct stat st;
+                if (stat(argv[i], &st) != 0)
+                {
+                    perror(argv[i]);
+                    continue;
+                }
+                files.emplace_back((uint64_t)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000, argv[i]);
+            }
+            std::sort(files.begin(), files.end());
+            TimelapseWriter writer(base);
+            uint32_t seq = (uint32_t)writer.count();
+            for (auto &f : files)
+            {
+                TimelapseMappedFile jpeg(f.second);
+                writer.append(f.first, jpeg.data, (uint32_t)jpeg.size, seq++, 0, crc32Update(0, jpeg.data, jpeg.size));
+            }
+            printf("%zu frames imported, %llu in archive\n", files.size(), (unsigned long long)writer.count());
+            return 0;
+        }
+
+        TimelapseReader reader(base);
+        if (cmd == "info")
+        {
+            uint64_t bytes = 0;
+            for (size_t i = 0; i < reader.size(); ++i)
+                bytes += reader.record(i).length;
+            printf("frames %zu, bytes %llu\n", reader.size(), (unsigned long long)bytes);
+            if (reader.size())
+                printf("from %s to %s\n", formatTime(reader.record(0).timeMs).c_str(),
+                       formatTime(reader.record(reader.size() - 1).timeMs).c_str());
+            return 0;
+        }
+        if (cmd == "list")
+        {
+            uint64_t from = 0, to = UINT64_MAX;
+            if ((argc > 3 && !parseTime(argv[3], from)) || (argc > 4 && !parseTime(argv[4], to)))
+                return usage();
+            for (size_t i = reader.seek(from); i < reader.size() && reader.record(i).timeMs < to; ++i)
+                printRecord(i, reader.record(i));
+            return 0;
+        }
+        if (cmd == "at" && argc == 5)
+        {
+            uint64_t t;
+            if (!parseTime(argv[3], t))
+                return usage();
+            if (!reader.size())
+            {
+                fprintf(stderr, "archive is empty\n");
+                return 1;
+            }
+            size_t i = reader.nearest(t);
+            printRecord(i, reader.record(i));
+            return writeFile(argv[4], reader.frame(i), reader.record(i).length) ? 0 : 1;
+        }
+        if (cmd == "extract" && argc == 6)
+        {
+            uint64_t from, to;
+            if (!parseTime(argv[3], from) || !parseTime(argv[4], to))
+                return usage();
+            size_t n = 0;
+            for (size_t i = reader.seek(from); i < reader.size() && reader.record(i).timeMs < to; ++i, ++n)
+            {
+                const TimelapseRecord &r = reader.record(i);
+                char name[64];
+                snprintf(name, sizeof(name), "/%llu_%u.jpg", (unsigned long long)r.timeMs, r.seq);
+                if (!writeFile(std::string(argv[5]) + name, reader.frame(i), r.length))
+                    return 1;
+            }
+            printf("%zu frames extracted\n", n);
+            return 0;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return usage();
+}
@@ -0,0 +1,271 @@
+/**
+ * @file timelapse_archive.h
+ * @brief Append-only timelapse archive: one segment file plus a fixed-size index.
+ *
+ * An archive `<base>` is two files:
+ *
+ *   <base>.seg  the JPEGs, back to back
+ *   <base>.idx  a 16-byte header followed by one 32-byte TimelapseRecord per
+ *               frame, in capture order (timestamps never decrease)
+ *
+ * Because index records have a fixed size and are sorted by time, the
+ * reader maps the index and finds any time with a binary search, then maps
+ * the frame straight out of the segment file. Nothing is scanned and there
+ * is one file pair per season instead of a directory of loose files.
+ *
+ * The writer appends the frame before its index record, so a crash leaves
+ * at most unindexed bytes at the end of the segment; they are truncated
+ * the next time the archive is opened for writing. After a power loss the
+ * filesystem may still have kept index records whose frame never reached
+ * the segment; the reader ignores them and the writer cuts them off.
+ *
+ * All integers are little-endian (the host byte order on x86 and ARM Linux).
+ */
+#pragma once
+
+#include <algorithm>
+#include <errno.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** One index entry. */
+struct TimelapseRecord
+{
+    uint64_t timeMs;   ///< Unix time of the frame in ms (host receive time)
+    uint64_t offset;   ///< Byte offset of the JPEG in the segment file
+    uint32_t length;   ///< JPEG length in bytes
+    uint32_t seq;      ///< Device sequence number
+    uint32_t deviceMs; ///< Device timestamp (ms since boot)
+    uint32_t crc;      ///< CRC-32 of the JPEG
+};
+static_assert(sizeof(TimelapseRecord) == 32, "index records must stay 32 bytes");
+
+struct TimelapseIndexHeader
+{
+    char magic[4];       ///< "AGTL"
+    uint16_t version;    ///< 1
+    uint16_t recordSize; ///< sizeof(TimelapseRecord)
+    uint64_t reserved;
+};
+static_assert(sizeof(TimelapseIndexHeader) == 16, "index header must stay 16 bytes");
+
+static const char TIMELAPSE_MAGIC[4] = {'A', 'G', 'T', 'L'};
+
+/** Write all of `n` bytes at `p` to `fd`. */
+inline void timelapseWriteAll(int fd, const void *p, size_t n)
+{
+    const uint8_t *b = (const uint8_t *)p;
+    while (n)
+    {
+        ssize_t w = write(fd, b, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            throw std::runtime_error("timelapse: write failed");
+        b += w;
+        n -= (size_t)w;
+    }
+}
+
+class TimelapseWriter
+{
+public:
+    /** Open or create the archive `<base>.seg` / `<base>.idx` for appending. */
+    explicit TimelapseWriter(const std::string &base)
+    {
+        _idx = open((base + ".idx").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        _seg = open((base + ".seg").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_idx < 0 || _seg < 0)
+        {
+            closeAll();
+            throw std::runtime_error("timelapse: cannot open " + base);
+        }
+
+        struct stat st;
+        struct stat segSt;
+        if (fstat(_idx, &st) != 0 || fstat(_seg, &segSt) != 0)
+            fail("timelapse: cannot stat " + base + ": " + strerror(errno));
+        if (st.st_size == 0)
+        {
+            TimelapseIndexHeader h = {};
+            memcpy(h.magic, TIMELAPSE_MAGIC, 4);
+            h.version = 1;
+            h.recordSize = sizeof(TimelapseRecord);
+            timelapseWriteAll(_idx, &h, sizeof(h));
+            _count = 0;
+        }
+        else
+        {
+            TimelapseIndexHeader h;
+            if (pread(_idx, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, TIMELAPSE_MAGIC, 4) ||
+                h.recordSize != sizeof(TimelapseRecord))
+                fail("timelapse: " + base + ".idx is not a timelapse index");
+            // Drop a torn trailing record and any records whose frame is not
+            // fully in the segment (the index reached disk, the data did not),
+            // then any segment bytes the remaining records do not index.
+            _count = (st.st_size - sizeof(h)) / sizeof(TimelapseRecord);
+            while (_count)
+            {
+                TimelapseRecord last;
+                if (pread(_idx, &last, sizeof(last), sizeof(h) + (_count - 1) * sizeof(TimelapseRecord)) !=
+                    (ssize_t)sizeof(last))
+                    fail("timelapse: cannot read the last record of " + base + ".idx");
+                if (last.offset + last.length <= (uint64_t)segSt.st_size)
+                {
+                    _end = last.offset + last.length;
+                    _lastTimeMs = last.timeMs;
+                    break;
+                }
+                _count--;
+            }
+            if (ftruncate(_idx, sizeof(h) + _count * sizeof(TimelapseRecord)) != 0)
+                fail("timelapse: cannot repair index");
+        }
+        if (ftruncate(_seg, (off_t)_end) != 0)
+            fail("timelapse: cannot repair segment");
+        lseek(_seg, 0, SEEK_END);
+        lseek(_idx, 0, SEEK_END);
+    }
+
+    ~TimelapseWriter() { closeAll(); }
+
+    TimelapseWriter(const TimelapseWriter &) = delete;
+    TimelapseWriter &operator=(const TimelapseWriter &) = delete;
+
+    /**
+     * @brief Append one frame.
+     *
+     * `timeMs` is clamped so the index stays sorted even if the host clock
+     * steps backwards.
+     */
+    void append(uint64_t timeMs, const uint8_t *jpeg, uint32_t length, uint32_t seq, uint32_t deviceMs, uint32_t crc)
+    {
+        if (timeMs < _lastTimeMs)
+            timeMs = _lastTimeMs;
+        TimelapseRecord r = {timeMs, _end, length, seq, deviceMs, crc};
+        timelapseWriteAll(_seg, jpeg, length);
+        timelapseWriteAll(_idx, &r, sizeof(r));
+        _end += length;
+        _lastTimeMs = timeMs;
+        _count++;
+    }
+
+    uint64_t count() const { return _count; }
+
+private:
+    /** Close both files and throw; the constructor must not leave them open. */
+    [[noreturn]] void fail(const std::string &message)
+    {
+        closeAll();
+        throw std::runtime_error(message);
+    }
+
+    void closeAll()
+    {
+        if (_idx >= 0)
+            close(_idx);
+        if (_seg >= 0)
+            close(_seg);
+        _idx = _seg = -1;
+    }
+
+    int _idx = -1;
+    int _seg = -1;
+    uint64_t _count = 0;
+    uint64_t _end = 0;
+    uint64_t _lastTimeMs = 0;
+};
+
+/** A whole file mapped read-only (empty files map to nullptr). */
+struct TimelapseMappedFile
+{
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    explicit TimelapseMappedFile(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("timelapse: cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("timelapse: cannot stat " + path);
+        }
+        size = (size_t)st.st_size;
+        if (size)
+        {
+            void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("timelapse: cannot map " + path);
+            }
+            data = (const uint8_t *)p;
+        }
+        close(fd);
+    }
+
+    ~TimelapseMappedFile()
+    {
+        if (data)
+            munmap((void *)data, size);
+    }
+
+    TimelapseMappedFile(const TimelapseMappedFile &) = delete;
+    TimelapseMappedFile &operator=(const TimelapseMappedFile &) = delete;
+};
+
+class TimelapseReader
+{
+public:
+    /** Map an archive read-only. */
+    explicit TimelapseReader(const std::string &base) : _idx(base + ".idx"), _seg(base + ".seg")
+    {
+        const TimelapseIndexHeader *h = (const TimelapseIndexHeader *)_idx.data;
+        if (_idx.size < sizeof(*h) || memcmp(h->magic, TIMELAPSE_MAGIC, 4) || h->recordSize != sizeof(TimelapseRecord))
+            throw std::runtime_error("timelapse: " + base + ".idx is not a timelapse index");
+        _records = (const TimelapseRecord *)(_idx.data + sizeof(*h));
+        _count = (_idx.size - sizeof(*h)) / sizeof(TimelapseRecord);
+        // Ignore records whose frame is not (yet) fully in the mapped segment.
+        while (_count && _records[_count - 1].offset + _records[_count - 1].length > _seg.size)
+            _count--;
+    }
+
+    size_t size() const { return _count; }
+    const TimelapseRecord &record(size_t i) const { return _records[i]; }
+    /** JPEG bytes of frame `i`, straight from the mapped segment. */
+    const uint8_t *frame(size_t i) const { return _seg.data + _records[i].offset; }
+
+    /** Index of the first frame at or after `timeMs` (size() if none). O(log n). */
+    size_t seek(uint64_t timeMs) const
+    {
+        const TimelapseRecord *r = std::lower_bound(_records, _records + _count, timeMs,
+                                                    [](const TimelapseRecord &a, uint64_t t) { return a.timeMs < t; });
+        return r - _records;
+    }
+
+    /** Index of the frame closest in time to `timeMs` (size() if the archive is empty). */
+    size_t nearest(uint64_t timeMs) const
+    {
+        size_t i = seek(timeMs);
+        if (i == _count)
+            return _count ? _count - 1 : 0;
+        if (i > 0 && timeMs - _records[i - 1].timeMs < _records[i].timeMs - timeMs)
+            return i - 1;
+        return i;
+    }
+
+private:
+    TimelapseMappedFile _idx;
+    TimelapseMappedFile _seg;
+    const TimelapseRecord *_records = nullptr;
+    size_t _count = 0;
+};